@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "arena.h"
+
+#define ARENA_FIRST_BLOCK_SIZE 4096
+#define ARENA_MAX_BLOCK_SIZE (1024 * 1024)
+
+
+//
+// arena_new_block
+//
+// Allocates a block with room for at least the given number
+// of bytes and pushes it on the front of the arena's chain.
+//
+static struct ARENA_BLOCK* arena_new_block(struct ARENA* arena, size_t size)
+{
+  if (size < arena->block_size) size = arena->block_size;
+
+  struct ARENA_BLOCK* block = (struct ARENA_BLOCK*)malloc(sizeof(struct ARENA_BLOCK) + size);
+  block->next = arena->blocks;
+  block->size = size;
+  block->used = 0;
+  arena->blocks = block;
+
+  // grow geometrically so large programs need few blocks
+  if (arena->block_size < ARENA_MAX_BLOCK_SIZE) arena->block_size *= 2;
+
+  return block;
+}
+
+
+//
+// arena_init
+//
+// Returns a pointer to a new, empty arena. No block is
+// allocated until the first allocation.
+//
+struct ARENA* arena_init(void)
+{
+  struct ARENA* arena = (struct ARENA*)malloc(sizeof(struct ARENA));
+  arena->blocks = NULL;
+  arena->block_size = ARENA_FIRST_BLOCK_SIZE;
+  arena->bytes_allocated = 0;
+  return arena;
+}
+
+
+//
+// arena_destroy
+//
+// Frees the arena and everything ever allocated from it,
+// one free per block rather than one per allocation.
+//
+void arena_destroy(struct ARENA* arena)
+{
+  if (arena == NULL) return;
+
+  struct ARENA_BLOCK* block = arena->blocks;
+  while (block != NULL) {
+    struct ARENA_BLOCK* next = block->next;
+    free(block);
+    block = next;
+  }
+  free(arena);
+}
+
+
+//
+// arena_reset
+//
+// Frees everything allocated from the arena, keeping only its
+// newest block to allocate from again, so an arena used over
+// and over for scratch work stops calling malloc once it has
+// grown to the size that work needs.
+//
+void arena_reset(struct ARENA* arena)
+{
+  struct ARENA_BLOCK* block = arena->blocks;
+  if (block == NULL) return;
+
+  struct ARENA_BLOCK* older = block->next;
+  while (older != NULL) {
+    struct ARENA_BLOCK* next = older->next;
+    free(older);
+    older = next;
+  }
+  block->next = NULL;
+  block->used = 0;
+  arena->bytes_allocated = 0;
+}
+
+
+//
+// arena_alloc_aligned
+//
+// Bumps the current block's offset to the given alignment
+// and carves size bytes from it, starting a new block if
+// the current one is full.
+//
+static void* arena_alloc_aligned(struct ARENA* arena, size_t size, size_t align)
+{
+  struct ARENA_BLOCK* block = arena->blocks;
+  size_t offset = 0;
+  if (block != NULL) offset = (block->used + align - 1) & ~(align - 1);
+
+  if (block == NULL || offset > block->size || block->size - offset < size) {
+    block = arena_new_block(arena, size);
+    offset = 0;
+  }
+
+  void* p = block->data + offset;
+  block->used = offset + size;
+  arena->bytes_allocated += size;
+  return p;
+}
+
+
+//
+// arena_alloc
+//
+// Returns a pointer to size bytes of uninitialized memory,
+// suitably aligned for any type. The memory stays valid
+// until the arena is destroyed.
+//
+void* arena_alloc(struct ARENA* arena, size_t size)
+{
+  return arena_alloc_aligned(arena, size, _Alignof(max_align_t));
+}
+
+
+//
+// arena_strdup
+//
+// Returns a copy of the given string allocated in the arena.
+//
+char* arena_strdup(struct ARENA* arena, const char* s)
+{
+  size_t length = strlen(s);
+  char* copy = (char*)arena_alloc_aligned(arena, length + 1, 1);
+  memcpy(copy, s, length + 1);
+  return copy;
+}
@@ -0,0 +1,31 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Define the structure for one block of arena memory; allocations are carved
+// from data in order, and blocks are chained so they can be freed together
+struct ARENA_BLOCK {
+    struct ARENA_BLOCK* next;
+    size_t size;
+    size_t used;
+    _Alignas(max_align_t) char data[];
+};
+
+// Define the ARENA structure, a bump allocator for data that lives until the
+// whole arena is destroyed (or reset). There is no way to free a single
+// allocation.
+struct ARENA {
+    struct ARENA_BLOCK* blocks;
+    size_t block_size;
+    size_t bytes_allocated;
+};
+
+// Function declarations for arena.c
+struct ARENA* arena_init(void);
+void arena_destroy(struct ARENA* arena);
+void arena_reset(struct ARENA* arena);
+void* arena_alloc(struct ARENA* arena, size_t size);
+char* arena_strdup(struct ARENA* arena, const char* s);
+
+#endif // ARENA_H
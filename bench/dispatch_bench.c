@@ -0,0 +1,122 @@
+//
+// dispatch_bench
+//
+// Measures the per-statement cost of running a program: the tree walker
+// (execute) against the bytecode VM (vm_run) on the same program graph.
+// The generated script is one while loop whose body is a long run of
+// short arithmetic and comparison assignments, so nearly all the time
+// goes to dispatching statements and operators rather than to memory or
+// output. Build from the repository root twice, once with the threaded
+// VM and once with its switch dispatch, and compare:
+//
+//   gcc -O2 -pthread -Iparser -Iram -Iarena -Iexecute/executor bench/dispatch_bench.c execute/executor/execute.c execute/executor/vm.c parser/parser.c parser/tokenqueue.c parser/intern.c parser/scanbuffer.c parser/scanparallel.c parser/scanner.c ram/ram.c arena/arena.c -lm -o dispatch_bench
+//   (the same with -DVM_SWITCH_DISPATCH) -o dispatch_bench_switch
+//
+// Optional arguments set the number of loop iterations (default 20000)
+// and of 8-statement groups in the loop body (default 32).
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "scanner.h"
+#include "parser.h"
+#include "execute.h"
+#include "vm.h"
+
+#define DEFAULT_ITERATIONS 20000
+#define DEFAULT_GROUPS 32
+#define NUM_RUNS 5
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void generate(FILE* output, int iterations, int groups)
+{
+  fprintf(output, "i = 0\n");
+  fprintf(output, "while i < %d:\n{\n", iterations);
+  for (int g = 0; g < groups; g++) {
+    fprintf(output, "  a%d = i + %d\n", g, g);
+    fprintf(output, "  b%d = a%d * 3\n", g, g);
+    fprintf(output, "  c%d = b%d - i\n", g, g);
+    fprintf(output, "  d%d = c%d < %d\n", g, g, g * 7);
+    fprintf(output, "  e%d = i %% 7\n", g);
+    fprintf(output, "  f%d = 2.5 * %d.0\n", g, g);
+    fprintf(output, "  g%d = f%d / 2.0\n", g, g);
+    fprintf(output, "  h%d = a%d == b%d\n", g, g, g);
+  }
+  fprintf(output, "  i = i + 1\n}\n$\n");
+}
+
+//
+// time_engine
+//
+// Returns the best time, in ns, of running the program on a fresh
+// memory with the tree walker or the VM; compiling is not timed.
+//
+static double time_engine(struct STMT* program, bool useVM)
+{
+  double best = 0;
+  for (int run = 0; run < NUM_RUNS; run++) {
+    struct RAM* memory = ram_init();
+    execute_resolve(program, memory);
+    struct VM_PROGRAM* vm = useVM ? vm_compile(program) : NULL;
+
+    double start = now_ns();
+    if (useVM)
+      vm_run(vm, memory);
+    else
+      execute(program, memory);
+    double elapsed = now_ns() - start;
+    if (run == 0 || elapsed < best) best = elapsed;
+
+    vm_destroy(vm);
+    ram_destroy(memory);
+  }
+  return best;
+}
+
+int main(int argc, char* argv[])
+{
+  int iterations = (argc > 1) ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+  int groups = (argc > 2) ? atoi(argv[2]) : DEFAULT_GROUPS;
+  if (iterations <= 0) iterations = DEFAULT_ITERATIONS;
+  if (groups <= 0) groups = DEFAULT_GROUPS;
+
+  char filename[] = "/tmp/dispatch_bench_XXXXXX";
+  FILE* output = fdopen(mkstemp(filename), "w");
+  generate(output, iterations, groups);
+  fclose(output);
+
+  struct ScannerSource source;
+  scanner_openFile(&source, filename);
+  struct ARENA* arena = arena_init();
+  struct STMT* program = parser_parseProgramSource(&source, arena);
+  if (program == NULL) {
+    printf("**ERROR: the generated script did not parse\n");
+    return 1;
+  }
+  execute_fold(program, arena);
+
+  // each iteration runs the body and tests the loop condition
+  double statements = (double)iterations * (groups * 8 + 2);
+
+#ifdef VM_SWITCH_DISPATCH
+  const char* name = "vm (switch dispatch)";
+#else
+  const char* name = "vm (threaded dispatch)";
+#endif
+  double tree = time_engine(program, false);
+  double vm = time_engine(program, true);
+  printf("%-24s %8.2f ns/statement\n", "tree walker", tree / statements);
+  printf("%-24s %8.2f ns/statement  (%.2fx)\n", name, vm / statements, tree / vm);
+
+  arena_destroy(arena);
+  scanner_close(&source);
+  remove(filename);
+  return 0;
+}
@@ -0,0 +1,90 @@
+//
+// keyword_bench
+//
+// Measures how fast the in-memory scanner (scanner_nextTokenSpan) gets
+// through a keyword-dense script, where nearly every identifier-shaped
+// lexeme has to be checked against the keywords and most operators are
+// the two-character kind. Build from the repository root twice, once
+// with the length-switched keyword lookup and once with the original
+// table search, and compare:
+//
+//   gcc -O2 -Iparser bench/keyword_bench.c parser/scanbuffer.c -o keyword_bench
+//   gcc -O2 -Iparser -DSCANNER_LINEAR_KEYWORDS bench/keyword_bench.c parser/scanbuffer.c -o keyword_bench_linear
+//
+// An optional argument sets the number of generated lines (default
+// 200000).
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "scanner.h"
+
+#define DEFAULT_LINES 200000
+#define NUM_RUNS 5
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void generate(FILE* output, int lines)
+{
+  static const char* const templates[] = {
+    "if x_%d is None:\n{\n  pass\n} elif y <= %d:\n{\n  z = True\n} else:\n{\n  z = False\n}\n",
+    "while a_%d in b and c >= %d:\n{\n  pass\n}\n",
+    "t = x ** %d != None == False\n",
+    "if True:\n{\n  is_set = q_%d >= %d\n}\n",
+  };
+  int count = (int)(sizeof(templates) / sizeof(templates[0]));
+  for (int i = 0; i < lines; i++)
+    fprintf(output, templates[i % count], i, i);
+  fprintf(output, "$\n");
+}
+
+int main(int argc, char* argv[])
+{
+  int lines = (argc > 1) ? atoi(argv[1]) : DEFAULT_LINES;
+  if (lines <= 0) lines = DEFAULT_LINES;
+
+  char filename[] = "/tmp/keyword_bench_XXXXXX";
+  FILE* output = fdopen(mkstemp(filename), "w");
+  generate(output, lines);
+  fclose(output);
+
+  double best = 0;
+  long tokens = 0;
+  long keywords = 0;
+  for (int run = 0; run < NUM_RUNS; run++) {
+    struct ScannerSource source;
+    struct TokenSpan span;
+    struct Token token;
+    scanner_openFile(&source, filename);
+    double start = now_ns();
+    tokens = 0;
+    keywords = 0;
+    do {
+      token = scanner_nextTokenSpan(&source, &span);
+      if ((token.id >= nuPy_KEYW_TRUE && token.id <= nuPy_KEYW_NONE) ||
+          (token.id >= nuPy_KEYW_IS && token.id <= nuPy_KEYW_PASS))
+        keywords++;
+      tokens++;
+    } while (token.id != nuPy_EOS);
+    double elapsed = now_ns() - start;
+    if (run == 0 || elapsed < best) best = elapsed;
+    scanner_close(&source);
+  }
+
+#ifdef SCANNER_LINEAR_KEYWORDS
+  const char* name = "linear keyword table";
+#else
+  const char* name = "length-switched keywords";
+#endif
+  printf("%-28s %8.2f Mtokens/s  (%ld tokens, %ld keywords)\n", name, tokens / best * 1e3, tokens, keywords);
+
+  remove(filename);
+  return 0;
+}
@@ -0,0 +1,109 @@
+//
+// ram_bench
+//
+// Measures the cost of variable-heavy loops against the public ram.h API:
+// a loop that reads, updates and writes every variable by address (what the
+// executor does after execute_resolve), the same loop by name, and a scan
+// that only inspects values. Build from the repository root with e.g.
+//
+//   gcc -O2 -Iram -Iarena bench/ram_bench.c ram/ram.c arena/arena.c -o ram_bench
+//
+// and add -DRAM_NANBOX to measure the NaN-boxed layout. An optional argument
+// sets the number of variables (default 20000); the number of passes shrinks
+// so every run performs about the same number of operations.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ram.h"
+
+#define DEFAULT_VARIABLES 20000
+#define TOTAL_OPS 10000000L
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char* name, double start, long ops, long checksum)
+{
+  double elapsed = now_ns() - start;
+  printf("%-28s %8.2f ns/op  (checksum %ld)\n", name, elapsed / ops, checksum);
+}
+
+int main(int argc, char* argv[])
+{
+  int NUM_VARIABLES = (argc > 1) ? atoi(argv[1]) : DEFAULT_VARIABLES;
+  if (NUM_VARIABLES <= 0) NUM_VARIABLES = DEFAULT_VARIABLES;
+  int NUM_PASSES = (int)(TOTAL_OPS / NUM_VARIABLES);
+  if (NUM_PASSES < 10) NUM_PASSES = 10;
+
+  struct RAM* memory = ram_init();
+  char name[32];
+  int* addresses = malloc(NUM_VARIABLES * sizeof(int));
+
+  for (int i = 0; i < NUM_VARIABLES; i++) {
+    struct RAM_VALUE value;
+    value.value_type = (i % 4 == 0) ? RAM_TYPE_REAL : RAM_TYPE_INT;
+    if (value.value_type == RAM_TYPE_REAL) value.types.d = i;
+    else value.types.i = i;
+    snprintf(name, sizeof(name), "var_%d", i);
+    ram_write_cell_by_name(memory, value, name);
+    addresses[i] = ram_get_addr(memory, name);
+  }
+
+  long ops = (long)NUM_VARIABLES * NUM_PASSES;
+
+  // read-modify-write by address
+  double start = now_ns();
+  for (int pass = 0; pass < NUM_PASSES; pass++) {
+    for (int i = 0; i < NUM_VARIABLES; i++) {
+      struct RAM_VALUE value;
+      ram_peek_cell_by_addr(memory, addresses[i], &value);
+      if (value.value_type == RAM_TYPE_INT) value.types.i += 1;
+      else value.types.d += 1.0;
+      ram_write_cell_by_addr(memory, value, addresses[i]);
+    }
+  }
+  long checksum = 0;
+  for (int i = 0; i < NUM_VARIABLES; i++) {
+    struct RAM_VALUE value;
+    ram_peek_cell_by_addr(memory, addresses[i], &value);
+    checksum += (value.value_type == RAM_TYPE_INT) ? value.types.i : (long)value.types.d;
+  }
+  report("update by address", start, ops, checksum);
+
+  // type scan: touches only the values, never the names
+  start = now_ns();
+  checksum = 0;
+  for (int pass = 0; pass < NUM_PASSES; pass++) {
+    for (int i = 0; i < NUM_VARIABLES; i++) {
+      struct RAM_VALUE value;
+      ram_peek_cell_by_addr(memory, i, &value);
+      checksum += value.value_type == RAM_TYPE_INT;
+    }
+  }
+  report("scan types by address", start, ops, checksum);
+
+  // read-modify-write by name
+  int name_passes = NUM_PASSES / 10 > 0 ? NUM_PASSES / 10 : 1;
+  start = now_ns();
+  for (int pass = 0; pass < name_passes; pass++) {
+    for (int i = 0; i < NUM_VARIABLES; i++) {
+      struct RAM_VALUE value;
+      snprintf(name, sizeof(name), "var_%d", i);
+      ram_peek_cell_by_name(memory, name, &value);
+      if (value.value_type == RAM_TYPE_INT) value.types.i += 1;
+      else value.types.d += 1.0;
+      ram_write_cell_by_name(memory, value, name);
+    }
+  }
+  report("update by name", start, (long)NUM_VARIABLES * name_passes, 0);
+
+  free(addresses);
+  ram_destroy(memory);
+  return 0;
+}
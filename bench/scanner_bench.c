@@ -0,0 +1,126 @@
+//
+// scanner_bench
+//
+// Measures scanning throughput in tokens per second: the stdio scanner
+// (scanner_nextToken, one fgetc at a time) against the in-memory scanner
+// (scanner_nextTokenSpan over a mapped file), serially and split across
+// threads by scanner_scanParallel. The input is a generated
+// script mixing identifiers, keywords, numbers, strings, operators and
+// comments, written to a temporary file. Build from the repository root
+// with e.g.
+//
+//   gcc -O2 -pthread -Iparser bench/scanner_bench.c parser/scanbuffer.c parser/scanparallel.c parser/scanner.c -o scanner_bench
+//
+// and add -mavx2 (32-byte strides) or -DSCANNER_NO_SIMD (scalar only) to
+// compare the character-class scanning variants. Optional arguments set the
+// number of generated lines (default 200000) and the largest thread count
+// to try (default 8).
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "scanner.h"
+
+#define DEFAULT_LINES 200000
+#define DEFAULT_THREADS 8
+#define NUM_RUNS 5
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char* name, double elapsed, long tokens)
+{
+  printf("%-28s %8.2f Mtokens/s  (%ld tokens)\n", name, tokens / elapsed * 1e3, tokens);
+}
+
+static void generate(FILE* output, int lines)
+{
+  static const char* const templates[] = {
+    "counter_%d = counter_%d + %d\n",
+    "    total_value_%d = total_value_%d * 3.14159 # running product %d\n",
+    "message_%d = 'a somewhat longer string literal number %d, %d'\n",
+    "while index_%d < %d:\n{\n  index_%d = index_%d + 1\n}\n",
+    "if flag_%d == True:\n{\n  print(\"flag was set\")\n}\nelse:\n{\n  pass\n}\n",
+    "# a comment line that the scanner has to skip entirely %d %d %d\n",
+  };
+  int count = (int)(sizeof(templates) / sizeof(templates[0]));
+  for (int i = 0; i < lines; i++)
+    fprintf(output, templates[i % count], i, i, i, i);
+  fprintf(output, "$\n");
+}
+
+int main(int argc, char* argv[])
+{
+  int lines = (argc > 1) ? atoi(argv[1]) : DEFAULT_LINES;
+  if (lines <= 0) lines = DEFAULT_LINES;
+  int maxThreads = (argc > 2) ? atoi(argv[2]) : DEFAULT_THREADS;
+  if (maxThreads <= 0) maxThreads = DEFAULT_THREADS;
+
+  char filename[] = "/tmp/scanner_bench_XXXXXX";
+  FILE* output = fdopen(mkstemp(filename), "w");
+  generate(output, lines);
+  fclose(output);
+
+  // stdio scanner
+  double best = 0;
+  long tokens = 0;
+  for (int run = 0; run < NUM_RUNS; run++) {
+    FILE* input = fopen(filename, "r");
+    int line, column;
+    char tokenValue[256];
+    double start = now_ns();
+    scanner_init(&line, &column, tokenValue);
+    tokens = 1;
+    while (scanner_nextToken(input, &line, &column, tokenValue).id != nuPy_EOS) tokens++;
+    double elapsed = now_ns() - start;
+    if (run == 0 || elapsed < best) best = elapsed;
+    fclose(input);
+  }
+  report("stdio scanner", best, tokens);
+
+  // in-memory scanner over the mapped file; mapping is not timed
+  long checksum = 0;
+  for (int run = 0; run < NUM_RUNS; run++) {
+    struct ScannerSource source;
+    struct TokenSpan span;
+    scanner_openFile(&source, filename);
+    double start = now_ns();
+    tokens = 1;
+    while (scanner_nextTokenSpan(&source, &span).id != nuPy_EOS) {
+      checksum += span.length;
+      tokens++;
+    }
+    double elapsed = now_ns() - start;
+    if (run == 0 || elapsed < best) best = elapsed;
+    scanner_close(&source);
+  }
+  report("span scanner", best, tokens);
+  printf("(checksum %ld)\n", checksum);
+
+  // the same, cut into chunks at newlines and scanned concurrently
+  for (int threads = 1; threads <= maxThreads; threads *= 2) {
+    int count = 0;
+    for (int run = 0; run < NUM_RUNS; run++) {
+      struct ScannerSource source;
+      scanner_openFile(&source, filename);
+      double start = now_ns();
+      struct SpanToken* scanned = scanner_scanParallel(&source, threads, &count);
+      double elapsed = now_ns() - start;
+      if (run == 0 || elapsed < best) best = elapsed;
+      free(scanned);
+      scanner_close(&source);
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "parallel scanner, %d thread%s", threads, threads == 1 ? "" : "s");
+    report(name, best, count);
+  }
+
+  remove(filename);
+  return 0;
+}
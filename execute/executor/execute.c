@@ -1,15 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <assert.h>
 #include <math.h>
 
 #include "execute.h"
+#include "parser.h"
 
 static bool execute_function_call(struct STMT* stmt, struct RAM* memory);
 static struct RAM_VALUE execute_get_value(struct UNARY_EXPR* unary, struct STMT* stmt, struct RAM* memory, bool* success);
-static struct RAM_VALUE execute_binary_expression(struct RAM_VALUE lhs, int operator, struct RAM_VALUE rhs, struct STMT* stmt, bool* success);
-static bool execute_assignment(struct STMT* stmt, struct RAM* memory);
 
 //
 // execute_function_call
@@ -28,16 +28,8 @@ static bool execute_function_call(struct STMT* stmt, struct RAM* memory)
   else {
     char* element_value = call->parameter->element_value;
     if (call->parameter->element_type == ELEMENT_STR_LITERAL) printf("%s\n", element_value);
-    else if (call->parameter->element_type == ELEMENT_INT_LITERAL) {
-      char* literal = element_value;
-      int i = atoi(literal);
-      printf("%d\n", i);
-    }
-    else if (call->parameter->element_type == ELEMENT_REAL_LITERAL) {
-      char* literal = element_value;
-      double i = atof(literal);
-      printf("%lf\n", i);
-    }
+    else if (call->parameter->element_type == ELEMENT_INT_LITERAL) printf("%d\n", call->parameter->value.types.i);
+    else if (call->parameter->element_type == ELEMENT_REAL_LITERAL) printf("%lf\n", call->parameter->value.types.d);
     else if (call->parameter->element_type == ELEMENT_TRUE || call->parameter->element_type == ELEMENT_FALSE) {
       char* literal = element_value;
       printf("%s\n", literal);
@@ -45,16 +37,16 @@ static bool execute_function_call(struct STMT* stmt, struct RAM* memory)
     else {
       assert(call->parameter->element_type == ELEMENT_IDENTIFIER);
       char* var_name = element_value;
-      struct RAM_VALUE* value = ram_read_cell_by_name(memory, var_name);
-      if (value == NULL) {
+      struct RAM_VALUE value;
+      if (!ram_peek_cell_by_addr(memory, call->parameter->address, &value)) {
         printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", var_name, stmt->line);
         return false;
       } // print depending on the value type
-      else if (value->value_type == RAM_TYPE_INT) printf("%d\n", value->types.i);
-      else if (value->value_type == RAM_TYPE_REAL) printf("%lf\n", value->types.d);
-      else if (value->value_type == RAM_TYPE_STR) printf("%s\n", value->types.s);
-      else if (value->value_type == RAM_TYPE_BOOLEAN && value->types.i == 1) printf("True\n");
-      else if (value->value_type == RAM_TYPE_BOOLEAN && value->types.i == 0) printf("False\n");
+      else if (value.value_type == RAM_TYPE_INT) printf("%d\n", value.types.i);
+      else if (value.value_type == RAM_TYPE_REAL) printf("%lf\n", value.types.d);
+      else if (value.value_type == RAM_TYPE_STR) printf("%s\n", value.types.str->chars);
+      else if (value.value_type == RAM_TYPE_BOOLEAN && value.types.i == 1) printf("True\n");
+      else if (value.value_type == RAM_TYPE_BOOLEAN && value.types.i == 0) printf("False\n");
     }
   }
 
@@ -62,10 +54,23 @@ static bool execute_function_call(struct STMT* stmt, struct RAM* memory)
 }
 
 
+//
+// release_value
+//
+// Drops the string reference held by a value, if any.
+//
+static void release_value(struct RAM_VALUE value)
+{
+  if (value.value_type == RAM_TYPE_STR) ram_str_release(value.types.str);
+}
+
+
 //
 // execute_get_value
 //
 // Given a unary expr, returns the value that it represents.
+// A string value carries its own reference, which the caller
+// must drop with release_value.
 //
 static struct RAM_VALUE execute_get_value(struct UNARY_EXPR* unary, struct STMT* stmt, struct RAM* memory, bool* success)
 {
@@ -75,59 +80,42 @@ static struct RAM_VALUE execute_get_value(struct UNARY_EXPR* unary, struct STMT*
 
   struct ELEMENT* element = unary->element;
 
-  if (element->element_type == ELEMENT_INT_LITERAL) {
-    value.value_type = RAM_TYPE_INT;
-    char* literal = element->element_value;
-
-    value.types.i = atoi(literal);
-    *success = true;
-  }
-  else if (element->element_type == ELEMENT_REAL_LITERAL) {
-    value.value_type = RAM_TYPE_REAL;
-    char* literal = element->element_value;
-    double temp = atof(literal);
-    value.types.d = temp;
-    *success = true;
-  }
-  else if (element->element_type == ELEMENT_STR_LITERAL) {
-    value.value_type = RAM_TYPE_STR;
-    char* literal = element->element_value;
-    value.types.s = literal;
-    *success = true;
-  }
-  else if (element->element_type == ELEMENT_TRUE || element->element_type == ELEMENT_FALSE) {
-    value.value_type = RAM_TYPE_BOOLEAN;
-    if (strcmp(element->element_value, "True") == 0) value.types.i = 1;
-    else value.types.i = 0;
+  if (element->element_type == ELEMENT_INT_LITERAL ||
+      element->element_type == ELEMENT_REAL_LITERAL ||
+      element->element_type == ELEMENT_STR_LITERAL ||
+      element->element_type == ELEMENT_TRUE ||
+      element->element_type == ELEMENT_FALSE) {
+    value = element->value;  // decoded when the graph was built
+    if (value.value_type == RAM_TYPE_STR) ram_str_retain(value.types.str);
     *success = true;
   }
   else {
     assert(element->element_type == ELEMENT_IDENTIFIER);
     char* var_name = element->element_value;
-    struct RAM_VALUE* ram_value = ram_read_cell_by_name(memory, var_name);
-    if (ram_value == NULL) {
+    struct RAM_VALUE ram_value;  // borrowed from memory, no copy is made
+    if (!ram_peek_cell_by_addr(memory, element->address, &ram_value)) {
       printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", var_name, stmt->line);
       *success = false;
     }
     else {
-      if (ram_value->value_type == RAM_TYPE_INT) {
+      if (ram_value.value_type == RAM_TYPE_INT) {
             value.value_type = RAM_TYPE_INT;
-            value.types.i = ram_value->types.i;
+            value.types.i = ram_value.types.i;
             *success = true;
       }
-      else if (ram_value->value_type == RAM_TYPE_BOOLEAN) {
+      else if (ram_value.value_type == RAM_TYPE_BOOLEAN) {
           value.value_type = RAM_TYPE_BOOLEAN;
-          value.types.i = ram_value->types.i;
+          value.types.i = ram_value.types.i;
           *success = true;
       }
-      else if (ram_value->value_type == RAM_TYPE_REAL) {
+      else if (ram_value.value_type == RAM_TYPE_REAL) {
         value.value_type = RAM_TYPE_REAL;
-        value.types.d = ram_value->types.d;
+        value.types.d = ram_value.types.d;
         *success = true;
       }
-      else if (ram_value->value_type == RAM_TYPE_STR) {
+      else if (ram_value.value_type == RAM_TYPE_STR) {
         value.value_type = RAM_TYPE_STR;
-        value.types.s = ram_value->types.s;
+        value.types.str = ram_str_retain(ram_value.types.str);
         *success = true;
       }
       else {
@@ -177,7 +165,7 @@ static void calc_rel_operator(struct RAM_VALUE lhs, int operator, struct RAM_VAL
       else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_REAL) result->types.i = lhs.types.d == rhs.types.d;
       else if (lhs.value_type == RAM_TYPE_INT && rhs.value_type == RAM_TYPE_REAL) result->types.i = lhs.types.i == rhs.types.d;
       else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_INT) result->types.i = lhs.types.d == rhs.types.i;
-      else if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) result->types.i = strcmp(lhs.types.s, rhs.types.s) == 0;
+      else if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) result->types.i = strcmp(lhs.types.str->chars, rhs.types.str->chars) == 0;
       else {
         printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", stmt->line);
         *success = false;
@@ -188,7 +176,7 @@ static void calc_rel_operator(struct RAM_VALUE lhs, int operator, struct RAM_VAL
       else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_REAL) result->types.i = lhs.types.d != rhs.types.d;
       else if (lhs.value_type == RAM_TYPE_INT && rhs.value_type == RAM_TYPE_REAL) result->types.i = lhs.types.i != rhs.types.d;
       else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_INT) result->types.i = lhs.types.d != rhs.types.i;
-      else if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) result->types.i = strcmp(lhs.types.s, rhs.types.s) != 0;
+      else if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) result->types.i = strcmp(lhs.types.str->chars, rhs.types.str->chars) != 0;
       else {
         printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", stmt->line);
         *success = false;
@@ -199,7 +187,7 @@ static void calc_rel_operator(struct RAM_VALUE lhs, int operator, struct RAM_VAL
       else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_REAL) result->types.i = lhs.types.d < rhs.types.d;
       else if (lhs.value_type == RAM_TYPE_INT && rhs.value_type == RAM_TYPE_REAL) result->types.i = lhs.types.i < rhs.types.d;
       else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_INT) result->types.i = lhs.types.d < rhs.types.i;
-      else if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) result->types.i = strcmp(lhs.types.s, rhs.types.s) < 0;
+      else if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) result->types.i = strcmp(lhs.types.str->chars, rhs.types.str->chars) < 0;
       else {
         printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", stmt->line);
         *success = false;
@@ -210,7 +198,7 @@ static void calc_rel_operator(struct RAM_VALUE lhs, int operator, struct RAM_VAL
       else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_REAL) result->types.i = lhs.types.d <= rhs.types.d;
       else if (lhs.value_type == RAM_TYPE_INT && rhs.value_type == RAM_TYPE_REAL) result->types.i = lhs.types.i <= rhs.types.d;
       else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_INT) result->types.i = lhs.types.d <= rhs.types.i;
-      else if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) result->types.i = strcmp(lhs.types.s, rhs.types.s) <= 0;
+      else if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) result->types.i = strcmp(lhs.types.str->chars, rhs.types.str->chars) <= 0;
       else {
         printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", stmt->line);
         *success = false;
@@ -221,7 +209,7 @@ static void calc_rel_operator(struct RAM_VALUE lhs, int operator, struct RAM_VAL
       else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_REAL) result->types.i = lhs.types.d > rhs.types.d;
       else if (lhs.value_type == RAM_TYPE_INT && rhs.value_type == RAM_TYPE_REAL) result->types.i = lhs.types.i > rhs.types.d;
       else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_INT) result->types.i = lhs.types.d > rhs.types.i;
-      else if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) result->types.i = strcmp(lhs.types.s, rhs.types.s) > 0;
+      else if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) result->types.i = strcmp(lhs.types.str->chars, rhs.types.str->chars) > 0;
       else {
         printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", stmt->line);
         *success = false;
@@ -232,7 +220,7 @@ static void calc_rel_operator(struct RAM_VALUE lhs, int operator, struct RAM_VAL
       else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_REAL) result->types.i = lhs.types.d >= rhs.types.d;
       else if (lhs.value_type == RAM_TYPE_INT && rhs.value_type == RAM_TYPE_REAL) result->types.i = lhs.types.i >= rhs.types.d;
       else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_INT) result->types.i = lhs.types.d >= rhs.types.i;
-      else if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) result->types.i = strcmp(lhs.types.s, rhs.types.s) >= 0;
+      else if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) result->types.i = strcmp(lhs.types.str->chars, rhs.types.str->chars) >= 0;
       else {
         printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", stmt->line);
         *success = false;
@@ -258,12 +246,7 @@ static void calculate(struct RAM_VALUE lhs, int operator, struct RAM_VALUE rhs,
       else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_REAL) result->types.d = lhs.types.d + rhs.types.d;
       else if (lhs.value_type == RAM_TYPE_INT && rhs.value_type == RAM_TYPE_REAL) result->types.d = lhs.types.i + rhs.types.d;
       else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_INT) result->types.d = lhs.types.d + rhs.types.i;
-      else if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) {
-        char *s = malloc(strlen(rhs.types.s) + strlen(lhs.types.s) + 1);
-        strcpy(s, lhs.types.s);
-        strcat(s, rhs.types.s);
-        result->types.s = s;
-      }
+      else if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) result->types.str = ram_str_concat(lhs.types.str, rhs.types.str);
       else {
         printf("**SEMANTIC ERROR: invalid operand types (line %d)\n", stmt->line);
         *success = false;
@@ -344,12 +327,12 @@ static void calculate(struct RAM_VALUE lhs, int operator, struct RAM_VALUE rhs,
 }
 
 //
-// execute_binary_expression
+// execute_operator
 //
 // Given two values and an operator, performs the operation
 // and returns the result.
 //
-static struct RAM_VALUE execute_binary_expression(struct RAM_VALUE lhs, int operator, struct RAM_VALUE rhs, struct STMT* stmt, bool* success)
+struct RAM_VALUE execute_operator(struct RAM_VALUE lhs, int operator, struct RAM_VALUE rhs, struct STMT* stmt, bool* success)
 {
   assert(operator != OPERATOR_NO_OP);
   struct RAM_VALUE result;
@@ -366,26 +349,214 @@ static struct RAM_VALUE execute_binary_expression(struct RAM_VALUE lhs, int oper
       operator == OPERATOR_GT ||
       operator == OPERATOR_GTE) calculate(lhs, operator, rhs, &result, stmt, success);
   else {
-    printf("**INTERNAL ERROR: unexpected operator (%d) in execute_binary_expr\n", operator);
+    printf("**INTERNAL ERROR: unexpected operator (%d) in execute_operator\n", operator);
     assert(false);
   }
   return result;
 }
 
+#ifndef EXECUTE_NO_QUICKEN
+
+//
+// Quickened operators
+//
+// Each binary expression starts out on the generic path above,
+// which re-tests the operand types on every evaluation. After
+// its first evaluation the expression is quickened: it keeps a
+// handler specialized to the operand types and operator it saw,
+// which tests both types once (the guard) and computes the
+// result directly. If the guard fails the expression goes back
+// to the generic path for that evaluation and is requickened to
+// the new types; after QUICKEN_MAX_MISSES failures it stays
+// generic, so polymorphic expressions do not keep flapping. The
+// handlers give the same results as calculate.
+// Build with -DEXECUTE_NO_QUICKEN to always take the generic path.
+//
+#define QUICKEN_MAX_MISSES 4
+
+#define QUICK(name, lhs_type, rhs_type, result_type, field, expression)                  \
+  static bool name(struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result) \
+  {                                                                                      \
+    if (lhs.value_type != lhs_type || rhs.value_type != rhs_type) return false;          \
+    result->value_type = result_type;                                                    \
+    result->types.field = expression;                                                    \
+    return true;                                                                         \
+  }
+
+// int op int
+QUICK(add_int_int, RAM_TYPE_INT, RAM_TYPE_INT, RAM_TYPE_INT, i, lhs.types.i + rhs.types.i)
+QUICK(sub_int_int, RAM_TYPE_INT, RAM_TYPE_INT, RAM_TYPE_INT, i, lhs.types.i - rhs.types.i)
+QUICK(mul_int_int, RAM_TYPE_INT, RAM_TYPE_INT, RAM_TYPE_INT, i, lhs.types.i * rhs.types.i)
+QUICK(pow_int_int, RAM_TYPE_INT, RAM_TYPE_INT, RAM_TYPE_INT, i, (int) pow(lhs.types.i, rhs.types.i))
+QUICK(mod_int_int, RAM_TYPE_INT, RAM_TYPE_INT, RAM_TYPE_INT, i, lhs.types.i % rhs.types.i)
+QUICK(div_int_int, RAM_TYPE_INT, RAM_TYPE_INT, RAM_TYPE_INT, i, lhs.types.i / rhs.types.i)
+QUICK(eq_int_int, RAM_TYPE_INT, RAM_TYPE_INT, RAM_TYPE_BOOLEAN, i, lhs.types.i == rhs.types.i)
+QUICK(ne_int_int, RAM_TYPE_INT, RAM_TYPE_INT, RAM_TYPE_BOOLEAN, i, lhs.types.i != rhs.types.i)
+QUICK(lt_int_int, RAM_TYPE_INT, RAM_TYPE_INT, RAM_TYPE_BOOLEAN, i, lhs.types.i < rhs.types.i)
+QUICK(lte_int_int, RAM_TYPE_INT, RAM_TYPE_INT, RAM_TYPE_BOOLEAN, i, lhs.types.i <= rhs.types.i)
+QUICK(gt_int_int, RAM_TYPE_INT, RAM_TYPE_INT, RAM_TYPE_BOOLEAN, i, lhs.types.i > rhs.types.i)
+QUICK(gte_int_int, RAM_TYPE_INT, RAM_TYPE_INT, RAM_TYPE_BOOLEAN, i, lhs.types.i >= rhs.types.i)
+
+// real op real
+QUICK(add_real_real, RAM_TYPE_REAL, RAM_TYPE_REAL, RAM_TYPE_REAL, d, lhs.types.d + rhs.types.d)
+QUICK(sub_real_real, RAM_TYPE_REAL, RAM_TYPE_REAL, RAM_TYPE_REAL, d, lhs.types.d - rhs.types.d)
+QUICK(mul_real_real, RAM_TYPE_REAL, RAM_TYPE_REAL, RAM_TYPE_REAL, d, lhs.types.d * rhs.types.d)
+QUICK(pow_real_real, RAM_TYPE_REAL, RAM_TYPE_REAL, RAM_TYPE_REAL, d, pow(lhs.types.d, rhs.types.d))
+QUICK(mod_real_real, RAM_TYPE_REAL, RAM_TYPE_REAL, RAM_TYPE_REAL, d, fmod(lhs.types.d, rhs.types.d))
+QUICK(div_real_real, RAM_TYPE_REAL, RAM_TYPE_REAL, RAM_TYPE_REAL, d, lhs.types.d / rhs.types.d)
+QUICK(eq_real_real, RAM_TYPE_REAL, RAM_TYPE_REAL, RAM_TYPE_BOOLEAN, i, lhs.types.d == rhs.types.d)
+QUICK(ne_real_real, RAM_TYPE_REAL, RAM_TYPE_REAL, RAM_TYPE_BOOLEAN, i, lhs.types.d != rhs.types.d)
+QUICK(lt_real_real, RAM_TYPE_REAL, RAM_TYPE_REAL, RAM_TYPE_BOOLEAN, i, lhs.types.d < rhs.types.d)
+QUICK(lte_real_real, RAM_TYPE_REAL, RAM_TYPE_REAL, RAM_TYPE_BOOLEAN, i, lhs.types.d <= rhs.types.d)
+QUICK(gt_real_real, RAM_TYPE_REAL, RAM_TYPE_REAL, RAM_TYPE_BOOLEAN, i, lhs.types.d > rhs.types.d)
+QUICK(gte_real_real, RAM_TYPE_REAL, RAM_TYPE_REAL, RAM_TYPE_BOOLEAN, i, lhs.types.d >= rhs.types.d)
+
+// int op real
+QUICK(add_int_real, RAM_TYPE_INT, RAM_TYPE_REAL, RAM_TYPE_REAL, d, lhs.types.i + rhs.types.d)
+QUICK(sub_int_real, RAM_TYPE_INT, RAM_TYPE_REAL, RAM_TYPE_REAL, d, lhs.types.i - rhs.types.d)
+QUICK(mul_int_real, RAM_TYPE_INT, RAM_TYPE_REAL, RAM_TYPE_REAL, d, lhs.types.i * rhs.types.d)
+QUICK(pow_int_real, RAM_TYPE_INT, RAM_TYPE_REAL, RAM_TYPE_REAL, d, pow(lhs.types.i, rhs.types.d))
+QUICK(mod_int_real, RAM_TYPE_INT, RAM_TYPE_REAL, RAM_TYPE_REAL, d, fmod(lhs.types.i, rhs.types.d))
+QUICK(div_int_real, RAM_TYPE_INT, RAM_TYPE_REAL, RAM_TYPE_REAL, d, lhs.types.i / rhs.types.d)
+QUICK(eq_int_real, RAM_TYPE_INT, RAM_TYPE_REAL, RAM_TYPE_BOOLEAN, i, lhs.types.i == rhs.types.d)
+QUICK(ne_int_real, RAM_TYPE_INT, RAM_TYPE_REAL, RAM_TYPE_BOOLEAN, i, lhs.types.i != rhs.types.d)
+QUICK(lt_int_real, RAM_TYPE_INT, RAM_TYPE_REAL, RAM_TYPE_BOOLEAN, i, lhs.types.i < rhs.types.d)
+QUICK(lte_int_real, RAM_TYPE_INT, RAM_TYPE_REAL, RAM_TYPE_BOOLEAN, i, lhs.types.i <= rhs.types.d)
+QUICK(gt_int_real, RAM_TYPE_INT, RAM_TYPE_REAL, RAM_TYPE_BOOLEAN, i, lhs.types.i > rhs.types.d)
+QUICK(gte_int_real, RAM_TYPE_INT, RAM_TYPE_REAL, RAM_TYPE_BOOLEAN, i, lhs.types.i >= rhs.types.d)
+
+// real op int
+QUICK(add_real_int, RAM_TYPE_REAL, RAM_TYPE_INT, RAM_TYPE_REAL, d, lhs.types.d + rhs.types.i)
+QUICK(sub_real_int, RAM_TYPE_REAL, RAM_TYPE_INT, RAM_TYPE_REAL, d, lhs.types.d - rhs.types.i)
+QUICK(mul_real_int, RAM_TYPE_REAL, RAM_TYPE_INT, RAM_TYPE_REAL, d, lhs.types.d * rhs.types.i)
+QUICK(pow_real_int, RAM_TYPE_REAL, RAM_TYPE_INT, RAM_TYPE_REAL, d, pow(lhs.types.d, rhs.types.i))
+QUICK(mod_real_int, RAM_TYPE_REAL, RAM_TYPE_INT, RAM_TYPE_REAL, d, fmod(lhs.types.d, rhs.types.i))
+QUICK(div_real_int, RAM_TYPE_REAL, RAM_TYPE_INT, RAM_TYPE_REAL, d, lhs.types.d / rhs.types.i)
+QUICK(eq_real_int, RAM_TYPE_REAL, RAM_TYPE_INT, RAM_TYPE_BOOLEAN, i, lhs.types.d == rhs.types.i)
+QUICK(ne_real_int, RAM_TYPE_REAL, RAM_TYPE_INT, RAM_TYPE_BOOLEAN, i, lhs.types.d != rhs.types.i)
+QUICK(lt_real_int, RAM_TYPE_REAL, RAM_TYPE_INT, RAM_TYPE_BOOLEAN, i, lhs.types.d < rhs.types.i)
+QUICK(lte_real_int, RAM_TYPE_REAL, RAM_TYPE_INT, RAM_TYPE_BOOLEAN, i, lhs.types.d <= rhs.types.i)
+QUICK(gt_real_int, RAM_TYPE_REAL, RAM_TYPE_INT, RAM_TYPE_BOOLEAN, i, lhs.types.d > rhs.types.i)
+QUICK(gte_real_int, RAM_TYPE_REAL, RAM_TYPE_INT, RAM_TYPE_BOOLEAN, i, lhs.types.d >= rhs.types.i)
+
+// str op str; only + and the relational operators apply
+QUICK(add_str_str, RAM_TYPE_STR, RAM_TYPE_STR, RAM_TYPE_STR, str, ram_str_concat(lhs.types.str, rhs.types.str))
+QUICK(eq_str_str, RAM_TYPE_STR, RAM_TYPE_STR, RAM_TYPE_BOOLEAN, i, strcmp(lhs.types.str->chars, rhs.types.str->chars) == 0)
+QUICK(ne_str_str, RAM_TYPE_STR, RAM_TYPE_STR, RAM_TYPE_BOOLEAN, i, strcmp(lhs.types.str->chars, rhs.types.str->chars) != 0)
+QUICK(lt_str_str, RAM_TYPE_STR, RAM_TYPE_STR, RAM_TYPE_BOOLEAN, i, strcmp(lhs.types.str->chars, rhs.types.str->chars) < 0)
+QUICK(lte_str_str, RAM_TYPE_STR, RAM_TYPE_STR, RAM_TYPE_BOOLEAN, i, strcmp(lhs.types.str->chars, rhs.types.str->chars) <= 0)
+QUICK(gt_str_str, RAM_TYPE_STR, RAM_TYPE_STR, RAM_TYPE_BOOLEAN, i, strcmp(lhs.types.str->chars, rhs.types.str->chars) > 0)
+QUICK(gte_str_str, RAM_TYPE_STR, RAM_TYPE_STR, RAM_TYPE_BOOLEAN, i, strcmp(lhs.types.str->chars, rhs.types.str->chars) >= 0)
+
+#undef QUICK
+
+// Handlers by operand types, then by operator (OPERATOR_PLUS through
+// OPERATOR_GTE); NULL where the operator does not apply to the types
+#define NUM_QUICK_OPERATORS (OPERATOR_GTE + 1)
+
+static const EXPR_HANDLER quick_int_int[NUM_QUICK_OPERATORS] = {
+  add_int_int, sub_int_int, mul_int_int, pow_int_int, mod_int_int, div_int_int,
+  eq_int_int, ne_int_int, lt_int_int, lte_int_int, gt_int_int, gte_int_int
+};
+static const EXPR_HANDLER quick_real_real[NUM_QUICK_OPERATORS] = {
+  add_real_real, sub_real_real, mul_real_real, pow_real_real, mod_real_real, div_real_real,
+  eq_real_real, ne_real_real, lt_real_real, lte_real_real, gt_real_real, gte_real_real
+};
+static const EXPR_HANDLER quick_int_real[NUM_QUICK_OPERATORS] = {
+  add_int_real, sub_int_real, mul_int_real, pow_int_real, mod_int_real, div_int_real,
+  eq_int_real, ne_int_real, lt_int_real, lte_int_real, gt_int_real, gte_int_real
+};
+static const EXPR_HANDLER quick_real_int[NUM_QUICK_OPERATORS] = {
+  add_real_int, sub_real_int, mul_real_int, pow_real_int, mod_real_int, div_real_int,
+  eq_real_int, ne_real_int, lt_real_int, lte_real_int, gt_real_int, gte_real_int
+};
+static const EXPR_HANDLER quick_str_str[NUM_QUICK_OPERATORS] = {
+  add_str_str, NULL, NULL, NULL, NULL, NULL,
+  eq_str_str, ne_str_str, lt_str_str, lte_str_str, gt_str_str, gte_str_str
+};
+
+//
+// quicken
+//
+// Records the operand types an expression was just evaluated
+// with, specializing it to them. The expression stays on the
+// generic path if it has missed too often, or if there is no
+// handler for the types (the generic path reports the error).
+//
+static void quicken(struct EXPR* expr, struct RAM_VALUE lhs, struct RAM_VALUE rhs)
+{
+  if (expr->quickened != NULL)  // the guard failed, the types changed
+    expr->misses++;
+  expr->quickened = NULL;
+  if (expr->misses > QUICKEN_MAX_MISSES || expr->operator < 0 || expr->operator >= NUM_QUICK_OPERATORS)
+    return;
+
+  const EXPR_HANDLER* handlers = NULL;
+  if (lhs.value_type == RAM_TYPE_INT && rhs.value_type == RAM_TYPE_INT) handlers = quick_int_int;
+  else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_REAL) handlers = quick_real_real;
+  else if (lhs.value_type == RAM_TYPE_INT && rhs.value_type == RAM_TYPE_REAL) handlers = quick_int_real;
+  else if (lhs.value_type == RAM_TYPE_REAL && rhs.value_type == RAM_TYPE_INT) handlers = quick_real_int;
+  else if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) handlers = quick_str_str;
+
+  if (handlers != NULL)
+    expr->quickened = handlers[expr->operator];
+}
+
+#endif // EXECUTE_NO_QUICKEN
+
+//
+// execute_expr
+//
+// Evaluates an expression and returns its value. Operands are
+// evaluated left to right, and evaluation stops at the first
+// semantic error. Binary expressions are quickened to the
+// operand types they see. The caller owns the result and
+// releases it with release_value.
+//
+static struct RAM_VALUE execute_expr(struct EXPR* expr, struct STMT* stmt, struct RAM* memory, bool* success)
+{
+  assert(expr->lhs != NULL);
+  struct RAM_VALUE lhs_value = execute_get_value(expr->lhs, stmt, memory, success);
+  if (!*success || !expr->isBinaryExpr)
+    return lhs_value;
+
+  assert(expr->operator != OPERATOR_NO_OP);  // we must have an operator
+  struct RAM_VALUE rhs_value = execute_get_value(expr->rhs, stmt, memory, success);
+  if (!*success) {  // semantic error
+    release_value(lhs_value);
+    return rhs_value;
+  }
+  struct RAM_VALUE result;
+#ifndef EXECUTE_NO_QUICKEN
+  // the quickened handler when the types are still the ones it was
+  // specialized to, otherwise the generic path (see quicken)
+  if (expr->quickened == NULL || !expr->quickened(lhs_value, rhs_value, &result)) {
+    quicken(expr, lhs_value, rhs_value);
+    result = execute_operator(lhs_value, expr->operator, rhs_value, stmt, success);
+  }
+#else
+  result = execute_operator(lhs_value, expr->operator, rhs_value, stmt, success);
+#endif
+  release_value(lhs_value);
+  release_value(rhs_value);
+  return result;
+}
+
 //
 // input_function
 //
 // Given a message to tell the user, receive an input and store it to memeory
+// at the given address
 //
-static struct RAM_VALUE input_function(char* msg, struct RAM* memory, struct STMT* stmt, char* var_name) {
+static struct RAM_VALUE input_function(char* msg, struct RAM* memory, struct STMT* stmt, int address) {
   struct RAM_VALUE result;
   result.value_type = RAM_TYPE_STR;
   printf("%s ", msg);
-  char *line = malloc(256);
-  char* literal = fgets(line, 256, stdin);
+  char line[256];
+  if (fgets(line, sizeof(line), stdin) == NULL) line[0] = '\0';
   line[strcspn(line, "\r\n")] = '\0';
-  result.types.s = literal;
-  ram_write_cell_by_name(memory, result, var_name);
+  result.types.str = ram_str_create(line, (int)strlen(line));
+  ram_write_cell_by_addr(memory, result, address);
   return result;
 }
 
@@ -398,9 +569,9 @@ static struct RAM_VALUE int_function(struct RAM_VALUE* val, struct RAM* memory,
   struct RAM_VALUE result;
   struct RAM_VALUE v1;
   v1.value_type = RAM_TYPE_STR;
-  v1.types.s = val->types.s;
+  v1.types.str = val->types.str;
   bool is_zero_string = true;
-  char *temp_string = v1.types.s;
+  char *temp_string = v1.types.str->chars;
   while (*temp_string != '\0') {
     if (*temp_string != '0') {
       is_zero_string = false;
@@ -413,9 +584,9 @@ static struct RAM_VALUE int_function(struct RAM_VALUE* val, struct RAM* memory,
     result.types.i = 0;
     *mini_success = true;
   }
-  else if (atoi(v1.types.s) != 0) {
+  else if (atoi(v1.types.str->chars) != 0) {
     result.value_type = RAM_TYPE_INT;
-    result.types.i = atoi(v1.types.s);
+    result.types.i = atoi(v1.types.str->chars);
     *mini_success = true;
   }
   else {
@@ -436,9 +607,9 @@ static struct RAM_VALUE float_function(struct RAM_VALUE* val, struct RAM* memory
   struct RAM_VALUE result;
   struct RAM_VALUE v2;
   v2.value_type = RAM_TYPE_STR;
-  v2.types.s = val->types.s;
+  v2.types.str = val->types.str;
   bool is_zero_string = true;
-  char *temp_string = v2.types.s;
+  char *temp_string = v2.types.str->chars;
   while (*temp_string != '\0') {
     if (*temp_string != '0' && *temp_string != '.') {
       is_zero_string = false;
@@ -452,9 +623,9 @@ static struct RAM_VALUE float_function(struct RAM_VALUE* val, struct RAM* memory
     *mini_success = true;
   }
   // Perform the conversion
-  else if (atof(v2.types.s) != 0) {
+  else if (atof(v2.types.str->chars) != 0) {
     result.value_type = RAM_TYPE_REAL;
-    result.types.d = atof(v2.types.s);
+    result.types.d = atof(v2.types.str->chars);
     *mini_success = true;
   }
   else {
@@ -471,48 +642,32 @@ static struct RAM_VALUE float_function(struct RAM_VALUE* val, struct RAM* memory
 //
 // Executes an assignment statement, returning true if 
 // successful and false if not
-static bool execute_assignment(struct STMT* stmt, struct RAM* memory)
+bool execute_assignment(struct STMT* stmt, struct RAM* memory)
 {
   struct STMT_ASSIGNMENT* assign = stmt->types.assignment;
-  char* var_name = assign->var_name;
   assert(assign->isPtrDeref == false);
   bool success;
   struct RAM_VALUE  result;
 
   if (assign->rhs->value_type == VALUE_EXPR) {
-    assert(assign->rhs->value_type == VALUE_EXPR);
-
-    struct EXPR* expr = assign->rhs->types.expr;
-    assert(expr->lhs != NULL);
-    struct RAM_VALUE lhs_value = execute_get_value(expr->lhs, stmt, memory, &success);
+    result = execute_expr(assign->rhs->types.expr, stmt, memory, &success);
     if (!success)  // semantic error
       return false;
-    if (!expr->isBinaryExpr) {
-      result = lhs_value;
-    }
-    else {
-      assert(expr->operator != OPERATOR_NO_OP);  // we must have an operator
-      struct RAM_VALUE rhs_value = execute_get_value(expr->rhs, stmt, memory, &success);
-      if (!success)  // semantic error
-        return false;
-      result = execute_binary_expression(lhs_value, expr->operator, rhs_value, stmt, &success);
-      if (!success) return false;
-    }
   }
   else {
     assert(assign->rhs->value_type == VALUE_FUNCTION_CALL);
     char* func_name = assign->rhs->types.function_call->function_name; // Check what type of function it is
-    if (strcmp(func_name, "input") == 0) result = input_function(assign->rhs->types.function_call->parameter->element_value, memory, stmt, var_name); 
+    if (strcmp(func_name, "input") == 0) result = input_function(assign->rhs->types.function_call->parameter->element_value, memory, stmt, assign->var_address); 
     else if (strcmp(func_name, "int") == 0) {
-      struct RAM_VALUE* temp = ram_read_cell_by_name(memory, assign->rhs->types.function_call->parameter->element_value);
-      if (temp == NULL) return false; // the value doesn't exist in memory
-      result = int_function(temp, memory, stmt, &success);
+      struct RAM_VALUE temp;
+      if (!ram_peek_cell_by_addr(memory, assign->rhs->types.function_call->parameter->address, &temp)) return false; // the value doesn't exist in memory
+      result = int_function(&temp, memory, stmt, &success);
       if (!success) return false;
     }
     else if (strcmp(func_name, "float") == 0) {
-      struct RAM_VALUE* temp = ram_read_cell_by_name(memory, assign->rhs->types.function_call->parameter->element_value);
-      if (temp == NULL) return false; // the value doesn't exist in memory
-      result = float_function(temp, memory, stmt, &success);
+      struct RAM_VALUE temp;
+      if (!ram_peek_cell_by_addr(memory, assign->rhs->types.function_call->parameter->address, &temp)) return false; // the value doesn't exist in memory
+      result = float_function(&temp, memory, stmt, &success);
       if (!success) return false;
     }
     else {
@@ -520,10 +675,338 @@ static bool execute_assignment(struct STMT* stmt, struct RAM* memory)
       return false;
     }
   }
-  success = ram_write_cell_by_name(memory, result, var_name);
+  success = ram_write_cell_by_addr(memory, result, assign->var_address);
+  release_value(result);  // memory holds its own reference now
   return success;
 }
 
+//
+// fold_string
+//
+// Allocates a string value of the given length in the arena,
+// for the caller to fill in. It is marked static, as literal
+// strings are, so it lives as long as the graph does.
+//
+static struct RAM_STR* fold_string(struct ARENA* arena, int length)
+{
+  struct RAM_STR* str = (struct RAM_STR*)arena_alloc(arena, sizeof(struct RAM_STR) + length + 1);
+  str->refcount = RAM_STR_STATIC;
+  str->length = length;
+  str->chars[length] = '\0';
+  return str;
+}
+
+//
+// compare_result
+//
+// Applies a relational operator to the order of its operands
+// (negative, zero or positive, as strcmp returns).
+//
+static int compare_result(int operator, int order)
+{
+  switch (operator) {
+    case OPERATOR_EQUAL: return order == 0;
+    case OPERATOR_NOT_EQUAL: return order != 0;
+    case OPERATOR_LT: return order < 0;
+    case OPERATOR_LTE: return order <= 0;
+    case OPERATOR_GT: return order > 0;
+    default: return order >= 0;
+  }
+}
+
+//
+// fold_values
+//
+// Computes lhs operator rhs for two literal values exactly as
+// execute would, returning false when the result is not
+// certain at this point: a semantic error, an operator that
+// has no value yet (is, in), or int division by zero and int
+// overflow, which are left to happen at run time.
+//
+static bool fold_values(struct ARENA* arena, struct RAM_VALUE lhs, int operator, struct RAM_VALUE rhs, struct RAM_VALUE* result)
+{
+  bool relational = operator >= OPERATOR_EQUAL && operator <= OPERATOR_GTE;
+  bool lhs_number = lhs.value_type == RAM_TYPE_INT || lhs.value_type == RAM_TYPE_REAL;
+  bool rhs_number = rhs.value_type == RAM_TYPE_INT || rhs.value_type == RAM_TYPE_REAL;
+  int order;
+
+  if (lhs.value_type == RAM_TYPE_INT && rhs.value_type == RAM_TYPE_INT) {
+    long long a = lhs.types.i, b = rhs.types.i, r;
+    if (relational)
+      order = (a > b) - (a < b);
+    else {
+      switch (operator) {
+        case OPERATOR_PLUS: r = a + b; break;
+        case OPERATOR_MINUS: r = a - b; break;
+        case OPERATOR_ASTERISK: r = a * b; break;
+        case OPERATOR_POWER: {
+          double p = pow(lhs.types.i, rhs.types.i);
+          if (!(p >= INT_MIN && p <= INT_MAX)) return false;
+          r = (int)p;
+          break;
+        }
+        case OPERATOR_MOD:
+        case OPERATOR_DIV:
+          if (b == 0 || (a == INT_MIN && b == -1)) return false;
+          r = (operator == OPERATOR_MOD) ? a % b : a / b;
+          break;
+        default: return false;
+      }
+      if (r < INT_MIN || r > INT_MAX) return false;
+      result->value_type = RAM_TYPE_INT;
+      result->types.i = (int)r;
+      return true;
+    }
+  }
+  else if (lhs_number && rhs_number) {
+    double a = (lhs.value_type == RAM_TYPE_INT) ? lhs.types.i : lhs.types.d;
+    double b = (rhs.value_type == RAM_TYPE_INT) ? rhs.types.i : rhs.types.d;
+    if (relational) {
+      if (isnan(a) || isnan(b)) return false;
+      order = (a > b) - (a < b);
+    }
+    else {
+      result->value_type = RAM_TYPE_REAL;
+      switch (operator) {
+        case OPERATOR_PLUS: result->types.d = a + b; break;
+        case OPERATOR_MINUS: result->types.d = a - b; break;
+        case OPERATOR_ASTERISK: result->types.d = a * b; break;
+        case OPERATOR_POWER: result->types.d = pow(a, b); break;
+        case OPERATOR_MOD: result->types.d = fmod(a, b); break;
+        case OPERATOR_DIV: result->types.d = a / b; break;
+        default: return false;
+      }
+      return true;
+    }
+  }
+  else if (lhs.value_type == RAM_TYPE_STR && rhs.value_type == RAM_TYPE_STR) {
+    if (relational)
+      order = strcmp(lhs.types.str->chars, rhs.types.str->chars);
+    else if (operator == OPERATOR_PLUS) {
+      struct RAM_STR* str = fold_string(arena, lhs.types.str->length + rhs.types.str->length);
+      memcpy(str->chars, lhs.types.str->chars, lhs.types.str->length);
+      memcpy(str->chars + lhs.types.str->length, rhs.types.str->chars, rhs.types.str->length);
+      result->value_type = RAM_TYPE_STR;
+      result->types.str = str;
+      return true;
+    }
+    else return false;
+  }
+  else return false;
+
+  result->value_type = RAM_TYPE_BOOLEAN;
+  result->types.i = compare_result(operator, order);
+  return true;
+}
+
+//
+// fold_expr
+//
+// Replaces a binary expression of two literals by a single
+// literal holding its value, when fold_values can compute it.
+// The literal's text is only for display; the graph is run
+// from its value. Anything fold_expr allocates goes in the
+// arena.
+//
+static void fold_expr(struct ARENA* arena, struct EXPR* expr)
+{
+  if (!expr->isBinaryExpr) return;
+  if (expr->lhs->expr_type != UNARY_ELEMENT || expr->rhs->expr_type != UNARY_ELEMENT) return;
+
+  struct RAM_VALUE result;
+  if (!fold_values(arena, expr->lhs->element->value, expr->operator, expr->rhs->element->value, &result)) return;
+
+  struct ELEMENT* literal = expr->lhs->element;
+  char text[32];
+  literal->value = result;
+  if (result.value_type == RAM_TYPE_INT) {
+    literal->element_type = ELEMENT_INT_LITERAL;
+    snprintf(text, sizeof(text), "%d", result.types.i);
+  }
+  else if (result.value_type == RAM_TYPE_REAL) {
+    literal->element_type = ELEMENT_REAL_LITERAL;
+    snprintf(text, sizeof(text), "%.17g", result.types.d);
+  }
+  else if (result.value_type == RAM_TYPE_BOOLEAN) {
+    literal->element_type = result.types.i ? ELEMENT_TRUE : ELEMENT_FALSE;
+    strcpy(text, result.types.i ? "True" : "False");
+  }
+  else {
+    literal->element_type = ELEMENT_STR_LITERAL;
+    text[0] = '\0';
+  }
+  if (result.value_type == RAM_TYPE_STR)
+    literal->element_value = result.types.str->chars;
+  else {
+    literal->element_value = (char*)arena_alloc(arena, strlen(text) + 1);
+    strcpy(literal->element_value, text);
+  }
+
+  expr->isBinaryExpr = false;
+  expr->operator = OPERATOR_NO_OP;
+  expr->rhs = NULL;
+}
+
+//
+// fold_stmts
+//
+// Folds the expressions of every statement from stmt up to (but
+// not including) stop, walking the graph as resolve_stmts does.
+//
+static void fold_stmts(struct STMT* stmt, struct STMT* stop, struct ARENA* arena)
+{
+  while (stmt != NULL && stmt != stop) {
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct STMT_ASSIGNMENT* assign = stmt->types.assignment;
+      if (assign->rhs->value_type == VALUE_EXPR) fold_expr(arena, assign->rhs->types.expr);
+      stmt = assign->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_FUNCTION_CALL)
+      stmt = stmt->types.function_call->next_stmt;
+    else if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+      struct STMT_IF_THEN_ELSE* if_then_else = stmt->types.if_then_else;
+      fold_expr(arena, if_then_else->condition);
+      fold_stmts(if_then_else->true_path, if_then_else->next_stmt, arena);
+      fold_stmts(if_then_else->false_path, if_then_else->next_stmt, arena);
+      stmt = if_then_else->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      fold_expr(arena, stmt->types.while_loop->condition);
+      fold_stmts(stmt->types.while_loop->loop_body, stmt, arena);
+      stmt = stmt->types.while_loop->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_LAZY_BLOCK)
+      stmt = stmt->types.lazy_block->next_stmt;  // folded when it is built
+    else {
+      assert(stmt->stmt_type == STMT_PASS);
+      stmt = stmt->types.pass->next_stmt;
+    }
+  }
+}
+
+//
+// execute_fold
+//
+// Given a program graph, folds each binary expression of two
+// literals into a single literal holding its value, so it is
+// not computed again every time it runs.
+//
+void execute_fold(struct STMT* program, struct ARENA* arena)
+{
+  fold_stmts(program, NULL, arena);
+}
+
+//
+// resolve_element
+//
+// If the element is an identifier, binds it to its address in memory.
+//
+static void resolve_element(struct ELEMENT* element, struct RAM* memory)
+{
+  if (element != NULL && element->element_type == ELEMENT_IDENTIFIER)
+    element->address = ram_reserve_addr(memory, element->element_value);
+}
+
+//
+// resolve_expr
+//
+// Binds the identifiers on both sides of an expression.
+//
+static void resolve_expr(struct EXPR* expr, struct RAM* memory)
+{
+  resolve_element(expr->lhs->element, memory);
+  if (expr->isBinaryExpr) resolve_element(expr->rhs->element, memory);
+}
+
+//
+// reserve_name
+//
+// Reserves a cell for a name in a deferred block; memory is the
+// RAM, passed through parser_blockNames.
+//
+static void reserve_name(void* memory, char* name)
+{
+  ram_reserve_addr((struct RAM*)memory, name);
+}
+
+//
+// resolve_stmts
+//
+// Binds the identifiers of every statement from stmt up to (but
+// not including) stop. Loop bodies link back to their while
+// statement and if/else paths link forward to the statement after
+// the if, so those are used as the stopping points for nested paths.
+//
+static void resolve_stmts(struct STMT* stmt, struct STMT* stop, struct RAM* memory)
+{
+  while (stmt != NULL && stmt != stop) {
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct STMT_ASSIGNMENT* assign = stmt->types.assignment;
+      assign->var_address = ram_reserve_addr(memory, assign->var_name);
+      if (assign->rhs->value_type == VALUE_EXPR) resolve_expr(assign->rhs->types.expr, memory);
+      else resolve_element(assign->rhs->types.function_call->parameter, memory);
+      stmt = assign->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      resolve_element(stmt->types.function_call->parameter, memory);
+      stmt = stmt->types.function_call->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+      struct STMT_IF_THEN_ELSE* if_then_else = stmt->types.if_then_else;
+      resolve_expr(if_then_else->condition, memory);
+      resolve_stmts(if_then_else->true_path, if_then_else->next_stmt, memory);
+      resolve_stmts(if_then_else->false_path, if_then_else->next_stmt, memory);
+      stmt = if_then_else->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      resolve_expr(stmt->types.while_loop->condition, memory);
+      resolve_stmts(stmt->types.while_loop->loop_body, stmt, memory);
+      stmt = stmt->types.while_loop->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_LAZY_BLOCK) {
+      // not built yet, so its nodes are bound when execution first
+      // gets there; its names are reserved now, in source order
+      parser_blockNames(stmt, reserve_name, memory);
+      stmt = stmt->types.lazy_block->next_stmt;
+    }
+    else {
+      assert(stmt->stmt_type == STMT_PASS);
+      stmt = stmt->types.pass->next_stmt;
+    }
+  }
+}
+
+//
+// execute_build_block
+//
+// Builds a deferred block the first time execution gets there,
+// then folds and binds it as execute_fold and execute_resolve
+// did the rest of the graph, from its first statement up to the
+// one it continues at. Returns the block's first statement.
+//
+struct STMT* execute_build_block(struct STMT* stmt, struct RAM* memory)
+{
+  struct STMT* next_stmt = stmt->types.lazy_block->next_stmt;
+  struct ARENA* arena = parser_blockArena(stmt);
+  struct STMT* block = parser_buildBlock(stmt);
+  fold_stmts(block, next_stmt, arena);
+  resolve_stmts(block, next_stmt, memory);
+  return block;
+}
+
+//
+// execute_resolve
+//
+// Given a program graph and a memory, binds every identifier in
+// the graph to a fixed address in memory, reserving undefined
+// cells for names that have not been written yet. After this,
+// execution reads and writes variables by address only.
+//
+void execute_resolve(struct STMT* program, struct RAM* memory)
+{
+  resolve_stmts(program, NULL, memory);
+}
+
 // execute
 //
 // Given a CPython program graph and a memory, 
@@ -547,19 +1030,37 @@ void execute(struct STMT* program, struct RAM* memory)
         return;
       stmt = stmt->types.function_call->next_stmt;
     }
-    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+    else if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+      struct STMT_IF_THEN_ELSE* if_then_else = stmt->types.if_then_else;
       bool success;
-      struct RAM_VALUE condition;
-      // use execute binary_expression and execute_get_value to check the while loop condition
-      if (!stmt->types.while_loop->condition->isBinaryExpr) condition = execute_get_value(stmt->types.while_loop->condition->lhs, stmt, memory, &success);
-      else condition = execute_binary_expression(execute_get_value(stmt->types.while_loop->condition->lhs, stmt, memory, &success), stmt->types.while_loop->condition->operator, execute_get_value(stmt->types.while_loop->condition->rhs, stmt, memory, &success), stmt, &success);
+      struct RAM_VALUE condition = execute_expr(if_then_else->condition, stmt, memory, &success);
       if (!success) return;
-      if (condition.types.i == 1) { // recursively call execute to simulate while loop
-        execute(stmt->types.while_loop->loop_body, memory);
-        return;
-      }
+      bool is_true = condition.types.i == 1;
+      release_value(condition);
+      // both paths link forward to the statement after the if
+      if (is_true)
+        stmt = if_then_else->true_path;
+      else if (if_then_else->false_path != NULL)
+        stmt = if_then_else->false_path;
+      else
+        stmt = if_then_else->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      bool success;
+      struct RAM_VALUE condition = execute_expr(stmt->types.while_loop->condition, stmt, memory, &success);
       if (!success) return;
-      stmt = stmt->types.while_loop->next_stmt;
+      bool is_true = condition.types.i == 1;
+      release_value(condition);
+      // the body's last statement links back to this one, so running the
+      // body brings execution back here to test the condition again
+      if (is_true)
+        stmt = stmt->types.while_loop->loop_body;
+      else
+        stmt = stmt->types.while_loop->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_LAZY_BLOCK) {
+      // first time here: build the block, then run it
+      stmt = execute_build_block(stmt, memory);
     }
     else {
       assert(stmt->stmt_type == STMT_PASS);
@@ -3,35 +3,37 @@
 
 #include <stdbool.h>
 
-struct STMT_FUNCTION_CALL;
-
-enum STMT_TYPE {
-    STMT_ASSIGNMENT,
-    STMT_FUNCTION_CALL,
-    STMT_BINARY_EXPR,
-};
-
-struct STMT {
-    enum STMT_TYPE type;
-    char* variable;
-    struct UNARY_EXPR* unary;
-    struct RAM_VALUE* lhs;
-    struct RAM_VALUE* rhs;
-    struct STMT_FUNCTION_CALL* function_call;
-};
-
-struct STMT_FUNCTION_CALL {
-    char* function_name;
-    struct RAM_VALUE** args;
-    size_t num_args;
-};
-
-struct UNARY_EXPR {
-    char* variable;
-};
-
-struct ELEMENT {
-    struct STMT* stmt;
-};
+#include "programgraph.h"
+#include "ram.h"
+#include "arena.h"
+
+// Binds every identifier in the program graph to a fixed address in memory.
+// Must be called once, after the graph is built and before execute. The names
+// in deferred blocks (STMT_LAZY_BLOCK) are reserved now, in source order, so
+// memory is laid out as for the eager graph; their nodes are bound later, as
+// execute builds them.
+void execute_resolve(struct STMT* program, struct RAM* memory);
+
+// Folds every binary expression of two literals in the program graph into a
+// literal holding its value, allocating what the folded literals need in the
+// arena (the graph's). Call it after the graph is built (or loaded from the
+// cache, which keeps graphs unfolded) and before execute_resolve.
+void execute_fold(struct STMT* program, struct ARENA* arena);
+
+// Builds a deferred block (STMT_LAZY_BLOCK) in place, folding and binding it
+// as execute_fold and execute_resolve would have; returns its first statement
+struct STMT* execute_build_block(struct STMT* block, struct RAM* memory);
+
+// Executes the program graph, stopping at the first semantic error
+void execute(struct STMT* program, struct RAM* memory);
+
+// Executes a single assignment statement, returning false on a semantic error
+// (which has been reported); the VM runs builtin calls through it
+bool execute_assignment(struct STMT* stmt, struct RAM* memory);
+
+// Applies a binary operator to two values, as the expression in stmt does,
+// and returns the result. A semantic error is reported and sets success to
+// false; otherwise success is left as it was. The operands are not released.
+struct RAM_VALUE execute_operator(struct RAM_VALUE lhs, int operator, struct RAM_VALUE rhs, struct STMT* stmt, bool* success);
 
 #endif // EXECUTE_H
@@ -10,29 +10,71 @@
 #include "parser.h"
 
 #include "programgraph.h" 
+#include "programcache.h"
 #include "ram.h"
 #include "execute.h"
+#include "vm.h"
 
 
 //
 // main
 // 
 // If a filename is given, the file is opened and serves as
-// input to the program. If a filename is not given, then 
+// input to the program; it is mapped into memory and
+// scanned in place. If a filename is not given, then 
 // input is taken from the keyboard until $ is input.
+// With --stats, memory statistics are printed after the
+// memory contents.
+//
+// A file's program graph is cached next to it (name.nupyc)
+// and reused until the file changes; --no-cache neither
+// reads nor writes the cache.
+//
+// With --lazy, a file's blocks are only parsed when they
+// first run (see parser_parseProgramLazy), so a large script
+// starts sooner; a graph built this way is not cached.
+//
+// --engine=vm compiles the program graph to bytecode and runs
+// that instead of walking the graph (--engine=tree, the default).
 //
 int main(int argc, char* argv[])
 {
   FILE* input = NULL;
+  struct ScannerSource source;
   bool  keyboardInput = false;
-  if (argc < 2) {
+  bool  printStats = false;
+  bool  useCache = true;
+  bool  lazy = false;
+  bool  useVM = false;
+  struct LAZY_SOURCE* deferred = NULL;
+  char* filename = NULL;
+  char* cachename = NULL;
+  struct PROGRAM_CACHE cache = { NULL, 0, NULL };
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--stats") == 0)
+      printStats = true;
+    else if (strcmp(argv[i], "--no-cache") == 0)
+      useCache = false;
+    else if (strcmp(argv[i], "--lazy") == 0)
+      lazy = true;
+    else if (strcmp(argv[i], "--engine=vm") == 0)
+      useVM = true;
+    else if (strcmp(argv[i], "--engine=tree") == 0)
+      useVM = false;
+    else if (strncmp(argv[i], "--engine=", 9) == 0) {
+      printf("**ERROR: unknown engine '%s', expected vm or tree.\n", argv[i] + 9);
+      return 0;
+    }
+    else
+      filename = argv[i];
+  }
+
+  if (filename == NULL) {
     input = stdin;
     keyboardInput = true;
   }
   else {
-    char* filename = argv[1];
-    input = fopen(filename, "r");
-    if (input == NULL) {
+    if (!scanner_openFile(&source, filename)) {
       printf("**ERROR: unable to open input file '%s' for input.\n", filename);
       return 0;
     }
@@ -45,9 +87,23 @@ int main(int argc, char* argv[])
     printf("nuPython input (enter $ when you're done)>\n");
   }
 
-  struct TokenQueue* tokens = parser_parse(input);
+  // the parser builds the program graph as it goes, all in one arena;
+  // a graph loaded from the cache lives in the cache's mapping instead
+  struct ARENA* arena = arena_init();
+  struct STMT* program = NULL;
+  if (!keyboardInput && useCache) {
+    cachename = programcache_filename(filename);
+    program = programcache_load(cachename, &source, &cache);
+  }
+  if (program == NULL && !keyboardInput && lazy)
+    program = parser_parseProgramLazy(&source, arena, &deferred);
+  else if (program == NULL) {
+    program = keyboardInput ? parser_parseProgram(input, arena) : parser_parseProgramSource(&source, arena);
+    if (program != NULL && cachename != NULL)
+      programcache_save(cachename, &source, program);  // best effort
+  }
 
-  if (tokens == NULL)
+  if (program == NULL)
   {
     printf("**parsing failed...\n");
   }
@@ -55,20 +111,30 @@ int main(int argc, char* argv[])
   {
     printf("**parsing successful, valid syntax\n");
     printf("**building program graph...\n");
-
-    struct STMT* program = programgraph_build(tokens);
     printf("**executing...\n");
     struct RAM* memory = ram_init();
-    execute(program, memory);
+    execute_fold(program, arena);
+    execute_resolve(program, memory);
+    if (useVM) {
+      struct VM_PROGRAM* vm = vm_compile(program);
+      vm_run(vm, memory);
+      vm_destroy(vm);
+    }
+    else
+      execute(program, memory);
     printf("**done\n");
     ram_print(memory);
-    programgraph_destroy(program);
+    if (printStats)
+      ram_print_stats(memory);
     ram_destroy(memory);
-    tokenqueue_destroy(tokens);
   }
+  parser_releaseLazy(deferred);
+  arena_destroy(arena);
+  programcache_close(&cache);
+  free(cachename);
 
   if (!keyboardInput)
-    fclose(input);
+    scanner_close(&source);
 
   return 0;
 }
@@ -0,0 +1,509 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "programcache.h"
+
+#define PROGRAM_CACHE_MAGIC "NUPYC"
+#define PROGRAM_CACHE_VERSION 3
+#define PROGRAM_CACHE_ALIGN 8
+
+//
+// Layout of a cache file: a header, the graph's nodes and
+// strings, then the relocation table. The nodes are the very
+// structs of programgraph.h, and literals' string values the
+// very RAM_STRs (static, so never freed), except that each
+// pointer field holds the offset of its target from the start
+// of the file (0 for NULL). The relocation table lists the offset of
+// every non-NULL pointer field, so loading is one mmap and one
+// pass adding the mapping's address to each of those fields,
+// whatever the graph's shape. The header's checksum covers
+// everything after it, so a file damaged after it was written
+// is rejected before any of it is relocated. Files use the
+// native byte order and struct layout, which the layout
+// fingerprint guards.
+//
+struct PROGRAM_CACHE_HEADER {
+  char magic[8];
+  uint32_t version;
+  uint32_t layout;
+  uint64_t source_hash;
+  uint64_t source_length;
+  uint64_t image_size;    // header, nodes and strings
+  uint64_t num_relocs;
+  uint64_t program;       // offset of the first statement
+  uint64_t checksum;      // hash of the rest of the file
+};
+
+// what a pointer field points to, and so how to copy it
+enum PROGRAM_CACHE_KINDS {
+  KIND_STMT,
+  KIND_ASSIGNMENT,
+  KIND_FUNCTION_CALL_STMT,
+  KIND_IF_THEN_ELSE,
+  KIND_WHILE_LOOP,
+  KIND_PASS,
+  KIND_VALUE,
+  KIND_FUNCTION_CALL,
+  KIND_EXPR,
+  KIND_UNARY_EXPR,
+  KIND_ELEMENT,
+  KIND_STRING,
+  KIND_RAM_STR
+};
+
+// a pointer field in the image still to be filled in
+struct PENDING_FIELD {
+  size_t field;
+  const void* target;
+  int kind;
+};
+
+struct CACHE_WRITER {
+  char* image;
+  size_t size;
+  size_t capacity;
+  uint64_t* relocs;
+  size_t num_relocs;
+  size_t reloc_capacity;
+  const void** keys;      // open-addressing map from node address to offset
+  size_t* offsets;
+  size_t num_keys;
+  size_t key_capacity;    // always a power of 2
+  struct PENDING_FIELD* pending;
+  size_t num_pending;
+  size_t pending_capacity;
+};
+
+
+//
+// programcache_layout
+//
+// Returns a fingerprint of the node layouts, so a cache file
+// written by a build with different structs is never used.
+//
+static uint32_t programcache_layout(void)
+{
+  size_t sizes[] = {
+    sizeof(void*), sizeof(struct STMT), sizeof(struct STMT_ASSIGNMENT), sizeof(struct STMT_FUNCTION_CALL),
+    sizeof(struct STMT_IF_THEN_ELSE), sizeof(struct STMT_WHILE_LOOP), sizeof(struct STMT_PASS),
+    sizeof(struct VALUE), sizeof(struct FUNCTION_CALL), sizeof(struct EXPR), sizeof(struct UNARY_EXPR),
+    sizeof(struct ELEMENT), sizeof(struct RAM_VALUE), sizeof(struct RAM_STR)
+  };
+  uint32_t layout = 2166136261u;
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    layout ^= (uint32_t)sizes[i];
+    layout *= 16777619u;
+  }
+  return layout;
+}
+
+
+//
+// programcache_hash
+//
+// Continues a 64-bit FNV-1a hash (start from
+// PROGRAM_CACHE_HASH_SEED) over the bytes from begin to end.
+//
+#define PROGRAM_CACHE_HASH_SEED 14695981039346656037ull
+
+static uint64_t programcache_hash(uint64_t hash, const char* begin, const char* end)
+{
+  for (const char* p = begin; p < end; p++) {
+    hash ^= (unsigned char)*p;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+
+//
+// programcache_filename
+//
+// Returns the cache file name for the given script, in a
+// new string the caller frees.
+//
+char* programcache_filename(const char* scriptname)
+{
+  size_t length = strlen(scriptname);
+  if (length > 3 && strcmp(scriptname + length - 3, ".py") == 0) length -= 3;
+
+  char* cachename = (char*)malloc(length + sizeof(".nupyc"));
+  memcpy(cachename, scriptname, length);
+  strcpy(cachename + length, ".nupyc");
+  return cachename;
+}
+
+
+//
+// writer_append
+//
+// Appends a copy of size bytes to the image, aligned for
+// nodes (strings need no alignment), and returns its offset.
+//
+static size_t writer_append(struct CACHE_WRITER* writer, const void* data, size_t size, size_t align)
+{
+  size_t offset = (writer->size + align - 1) & ~(align - 1);
+  if (offset + size > writer->capacity) {
+    while (offset + size > writer->capacity) writer->capacity *= 2;
+    writer->image = (char*)realloc(writer->image, writer->capacity);
+  }
+  memset(writer->image + writer->size, 0, offset - writer->size);
+  memcpy(writer->image + offset, data, size);
+  writer->size = offset + size;
+  return offset;
+}
+
+
+//
+// writer_slot
+//
+// Returns the slot of the given node address in the map:
+// either where it is, or the empty slot where it belongs.
+//
+static size_t writer_slot(struct CACHE_WRITER* writer, const void* key)
+{
+  size_t mask = writer->key_capacity - 1;
+  size_t slot = ((uintptr_t)key >> 3) * 0x9E3779B97F4A7C15ull & mask;
+  while (writer->keys[slot] != NULL && writer->keys[slot] != key) slot = (slot + 1) & mask;
+  return slot;
+}
+
+
+//
+// writer_remember
+//
+// Records where a node was copied to, growing the map to
+// keep it at most half full.
+//
+static void writer_remember(struct CACHE_WRITER* writer, const void* key, size_t offset)
+{
+  if ((writer->num_keys + 1) * 2 > writer->key_capacity) {
+    const void** keys = writer->keys;
+    size_t* offsets = writer->offsets;
+    size_t capacity = writer->key_capacity;
+
+    writer->key_capacity *= 2;
+    writer->keys = (const void**)calloc(writer->key_capacity, sizeof(void*));
+    writer->offsets = (size_t*)malloc(writer->key_capacity * sizeof(size_t));
+    for (size_t i = 0; i < capacity; i++) {
+      if (keys[i] == NULL) continue;
+      size_t slot = writer_slot(writer, keys[i]);
+      writer->keys[slot] = keys[i];
+      writer->offsets[slot] = offsets[i];
+    }
+    free(keys);
+    free(offsets);
+  }
+
+  size_t slot = writer_slot(writer, key);
+  writer->keys[slot] = key;
+  writer->offsets[slot] = offset;
+  writer->num_keys++;
+}
+
+
+//
+// writer_defer
+//
+// Queues the pointer field at the given image offset to be
+// filled in with the offset of target's copy.
+//
+static void writer_defer(struct CACHE_WRITER* writer, size_t field, const void* target, int kind)
+{
+  if (writer->num_pending == writer->pending_capacity) {
+    writer->pending_capacity *= 2;
+    writer->pending = (struct PENDING_FIELD*)realloc(writer->pending, writer->pending_capacity * sizeof(struct PENDING_FIELD));
+  }
+  struct PENDING_FIELD* pending = &writer->pending[writer->num_pending++];
+  pending->field = field;
+  pending->target = target;
+  pending->kind = kind;
+}
+
+
+//
+// writer_copy
+//
+// Copies one node into the image and queues its pointer
+// fields. Resolved addresses and quickened handlers are reset,
+// since the cache is loaded into a fresh memory and process.
+//
+static size_t writer_copy(struct CACHE_WRITER* writer, const void* node, int kind)
+{
+  size_t at;
+  if (kind == KIND_STMT) {
+    const struct STMT* stmt = (const struct STMT*)node;
+    static const int kinds[] = { KIND_ASSIGNMENT, KIND_FUNCTION_CALL_STMT, KIND_IF_THEN_ELSE, KIND_WHILE_LOOP, KIND_PASS };
+    assert(stmt->stmt_type != STMT_LAZY_BLOCK);  // deferred blocks cannot be saved
+    at = writer_append(writer, stmt, sizeof(*stmt), PROGRAM_CACHE_ALIGN);
+    writer_defer(writer, at + offsetof(struct STMT, types), stmt->types.assignment, kinds[stmt->stmt_type]);
+  }
+  else if (kind == KIND_ASSIGNMENT) {
+    const struct STMT_ASSIGNMENT* assign = (const struct STMT_ASSIGNMENT*)node;
+    at = writer_append(writer, assign, sizeof(*assign), PROGRAM_CACHE_ALIGN);
+    ((struct STMT_ASSIGNMENT*)(writer->image + at))->var_address = -1;
+    writer_defer(writer, at + offsetof(struct STMT_ASSIGNMENT, var_name), assign->var_name, KIND_STRING);
+    writer_defer(writer, at + offsetof(struct STMT_ASSIGNMENT, rhs), assign->rhs, KIND_VALUE);
+    writer_defer(writer, at + offsetof(struct STMT_ASSIGNMENT, next_stmt), assign->next_stmt, KIND_STMT);
+  }
+  else if (kind == KIND_FUNCTION_CALL_STMT) {
+    const struct STMT_FUNCTION_CALL* call = (const struct STMT_FUNCTION_CALL*)node;
+    at = writer_append(writer, call, sizeof(*call), PROGRAM_CACHE_ALIGN);
+    writer_defer(writer, at + offsetof(struct STMT_FUNCTION_CALL, function_name), call->function_name, KIND_STRING);
+    writer_defer(writer, at + offsetof(struct STMT_FUNCTION_CALL, parameter), call->parameter, KIND_ELEMENT);
+    writer_defer(writer, at + offsetof(struct STMT_FUNCTION_CALL, next_stmt), call->next_stmt, KIND_STMT);
+  }
+  else if (kind == KIND_IF_THEN_ELSE) {
+    const struct STMT_IF_THEN_ELSE* if_then_else = (const struct STMT_IF_THEN_ELSE*)node;
+    at = writer_append(writer, if_then_else, sizeof(*if_then_else), PROGRAM_CACHE_ALIGN);
+    writer_defer(writer, at + offsetof(struct STMT_IF_THEN_ELSE, condition), if_then_else->condition, KIND_EXPR);
+    writer_defer(writer, at + offsetof(struct STMT_IF_THEN_ELSE, true_path), if_then_else->true_path, KIND_STMT);
+    writer_defer(writer, at + offsetof(struct STMT_IF_THEN_ELSE, false_path), if_then_else->false_path, KIND_STMT);
+    writer_defer(writer, at + offsetof(struct STMT_IF_THEN_ELSE, next_stmt), if_then_else->next_stmt, KIND_STMT);
+  }
+  else if (kind == KIND_WHILE_LOOP) {
+    const struct STMT_WHILE_LOOP* loop = (const struct STMT_WHILE_LOOP*)node;
+    at = writer_append(writer, loop, sizeof(*loop), PROGRAM_CACHE_ALIGN);
+    writer_defer(writer, at + offsetof(struct STMT_WHILE_LOOP, condition), loop->condition, KIND_EXPR);
+    writer_defer(writer, at + offsetof(struct STMT_WHILE_LOOP, loop_body), loop->loop_body, KIND_STMT);
+    writer_defer(writer, at + offsetof(struct STMT_WHILE_LOOP, next_stmt), loop->next_stmt, KIND_STMT);
+  }
+  else if (kind == KIND_PASS) {
+    const struct STMT_PASS* pass = (const struct STMT_PASS*)node;
+    at = writer_append(writer, pass, sizeof(*pass), PROGRAM_CACHE_ALIGN);
+    writer_defer(writer, at + offsetof(struct STMT_PASS, next_stmt), pass->next_stmt, KIND_STMT);
+  }
+  else if (kind == KIND_VALUE) {
+    const struct VALUE* value = (const struct VALUE*)node;
+    at = writer_append(writer, value, sizeof(*value), PROGRAM_CACHE_ALIGN);
+    if (value->value_type == VALUE_FUNCTION_CALL)
+      writer_defer(writer, at + offsetof(struct VALUE, types), value->types.function_call, KIND_FUNCTION_CALL);
+    else
+      writer_defer(writer, at + offsetof(struct VALUE, types), value->types.expr, KIND_EXPR);
+  }
+  else if (kind == KIND_FUNCTION_CALL) {
+    const struct FUNCTION_CALL* call = (const struct FUNCTION_CALL*)node;
+    at = writer_append(writer, call, sizeof(*call), PROGRAM_CACHE_ALIGN);
+    writer_defer(writer, at + offsetof(struct FUNCTION_CALL, function_name), call->function_name, KIND_STRING);
+    writer_defer(writer, at + offsetof(struct FUNCTION_CALL, parameter), call->parameter, KIND_ELEMENT);
+  }
+  else if (kind == KIND_EXPR) {
+    const struct EXPR* expr = (const struct EXPR*)node;
+    at = writer_append(writer, expr, sizeof(*expr), PROGRAM_CACHE_ALIGN);
+    ((struct EXPR*)(writer->image + at))->quickened = NULL;  // code addresses differ per run
+    ((struct EXPR*)(writer->image + at))->misses = 0;
+    writer_defer(writer, at + offsetof(struct EXPR, lhs), expr->lhs, KIND_UNARY_EXPR);
+    writer_defer(writer, at + offsetof(struct EXPR, rhs), expr->rhs, KIND_UNARY_EXPR);
+  }
+  else if (kind == KIND_UNARY_EXPR) {
+    const struct UNARY_EXPR* unary = (const struct UNARY_EXPR*)node;
+    at = writer_append(writer, unary, sizeof(*unary), PROGRAM_CACHE_ALIGN);
+    writer_defer(writer, at + offsetof(struct UNARY_EXPR, element), unary->element, KIND_ELEMENT);
+  }
+  else if (kind == KIND_ELEMENT) {
+    const struct ELEMENT* element = (const struct ELEMENT*)node;
+    at = writer_append(writer, element, sizeof(*element), PROGRAM_CACHE_ALIGN);
+    ((struct ELEMENT*)(writer->image + at))->address = -1;
+    writer_defer(writer, at + offsetof(struct ELEMENT, element_value), element->element_value, KIND_STRING);
+    if (element->value.value_type == RAM_TYPE_STR)
+      writer_defer(writer, at + offsetof(struct ELEMENT, value) + offsetof(struct RAM_VALUE, types), element->value.types.str, KIND_RAM_STR);
+  }
+  else if (kind == KIND_RAM_STR) {
+    const struct RAM_STR* str = (const struct RAM_STR*)node;
+    assert(str->refcount == RAM_STR_STATIC);
+    at = writer_append(writer, str, sizeof(*str) + str->length + 1, PROGRAM_CACHE_ALIGN);
+  }
+  else {
+    assert(kind == KIND_STRING);
+    at = writer_append(writer, node, strlen((const char*)node) + 1, 1);
+  }
+  return at;
+}
+
+
+//
+// programcache_save
+//
+// Copies the graph into an image node by node, working
+// through a queue of pointer fields rather than recursing,
+// since statement chains can be as long as the program.
+// Shared nodes (a path's last statement links to a statement
+// that is reached some other way too, and loop bodies link
+// back to their while) and interned strings are copied once.
+// The file is written under a unique temporary name in the
+// same directory and renamed into place, so a reader never
+// sees half of one and concurrent writers never share one.
+//
+bool programcache_save(const char* cachename, struct ScannerSource* source, struct STMT* program)
+{
+  struct CACHE_WRITER writer;
+  struct PROGRAM_CACHE_HEADER header;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC));
+  header.version = PROGRAM_CACHE_VERSION;
+  header.layout = programcache_layout();
+  header.source_hash = programcache_hash(PROGRAM_CACHE_HASH_SEED, source->begin, source->end);
+  header.source_length = (uint64_t)(source->end - source->begin);
+
+  writer.capacity = 4096;
+  writer.image = (char*)malloc(writer.capacity);
+  writer.size = 0;
+  writer_append(&writer, &header, sizeof(header), PROGRAM_CACHE_ALIGN);
+  writer.reloc_capacity = 256;
+  writer.relocs = (uint64_t*)malloc(writer.reloc_capacity * sizeof(uint64_t));
+  writer.num_relocs = 0;
+  writer.key_capacity = 256;
+  writer.keys = (const void**)calloc(writer.key_capacity, sizeof(void*));
+  writer.offsets = (size_t*)malloc(writer.key_capacity * sizeof(size_t));
+  writer.num_keys = 0;
+  writer.pending_capacity = 256;
+  writer.pending = (struct PENDING_FIELD*)malloc(writer.pending_capacity * sizeof(struct PENDING_FIELD));
+  writer.num_pending = 0;
+
+  assert(program != NULL);
+  size_t root = writer_copy(&writer, program, KIND_STMT);
+  writer_remember(&writer, program, root);
+  while (writer.num_pending > 0) {
+    struct PENDING_FIELD pending = writer.pending[--writer.num_pending];
+    uintptr_t target = 0;
+    if (pending.target != NULL) {
+      size_t slot = writer_slot(&writer, pending.target);
+      if (writer.keys[slot] != NULL) target = writer.offsets[slot];
+      else {
+        target = writer_copy(&writer, pending.target, pending.kind);
+        writer_remember(&writer, pending.target, target);
+      }
+
+      if (writer.num_relocs == writer.reloc_capacity) {
+        writer.reloc_capacity *= 2;
+        writer.relocs = (uint64_t*)realloc(writer.relocs, writer.reloc_capacity * sizeof(uint64_t));
+      }
+      writer.relocs[writer.num_relocs++] = pending.field;
+    }
+    memcpy(writer.image + pending.field, &target, sizeof(target));
+  }
+
+  struct PROGRAM_CACHE_HEADER* written = (struct PROGRAM_CACHE_HEADER*)writer.image;
+  written->program = root;
+  written->image_size = (writer.size + PROGRAM_CACHE_ALIGN - 1) & ~(size_t)(PROGRAM_CACHE_ALIGN - 1);
+  written->num_relocs = writer.num_relocs;
+  memset(writer.image + writer.size, 0, written->image_size - writer.size);
+  const char* relocs = (const char*)writer.relocs;
+  written->checksum = programcache_hash(PROGRAM_CACHE_HASH_SEED, writer.image + sizeof(header), writer.image + written->image_size);
+  written->checksum = programcache_hash(written->checksum, relocs, relocs + writer.num_relocs * sizeof(uint64_t));
+
+  size_t length = strlen(cachename);
+  char* tempname = (char*)malloc(length + sizeof(".XXXXXX"));
+  memcpy(tempname, cachename, length);
+  strcpy(tempname + length, ".XXXXXX");
+
+  int fd = mkstemp(tempname);
+  FILE* output = fd >= 0 ? fdopen(fd, "wb") : NULL;
+  if (fd >= 0 && output == NULL) close(fd);
+  bool success = output != NULL &&
+                 fwrite(writer.image, 1, written->image_size, output) == written->image_size &&
+                 fwrite(writer.relocs, sizeof(uint64_t), writer.num_relocs, output) == writer.num_relocs;
+  if (output != NULL && fclose(output) != 0) success = false;
+  if (success) success = rename(tempname, cachename) == 0;
+  if (!success && fd >= 0) remove(tempname);
+
+  free(tempname);
+  free(writer.image);
+  free(writer.relocs);
+  free(writer.keys);
+  free(writer.offsets);
+  free(writer.pending);
+  return success;
+}
+
+
+//
+// programcache_load
+//
+// Maps the cache file privately and writably, checks that it
+// belongs to this source and this build and that its checksum
+// matches, and relocates every pointer field in place.
+// Anything amiss, including a field or target outside the
+// image, rejects the whole file.
+//
+struct STMT* programcache_load(const char* cachename, struct ScannerSource* source, struct PROGRAM_CACHE* cache)
+{
+  cache->mapping = NULL;
+  cache->size = 0;
+  cache->program = NULL;
+
+  int fd = open(cachename, O_RDONLY);
+  if (fd < 0) return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct PROGRAM_CACHE_HEADER)) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t size = (size_t)st.st_size;
+  char* base = (char*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) return NULL;
+
+  struct PROGRAM_CACHE_HEADER* header = (struct PROGRAM_CACHE_HEADER*)base;
+  bool valid = memcmp(header->magic, PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC)) == 0 &&
+               header->version == PROGRAM_CACHE_VERSION &&
+               header->layout == programcache_layout() &&
+               header->source_length == (uint64_t)(source->end - source->begin) &&
+               header->image_size <= size &&
+               header->num_relocs == (size - header->image_size) / sizeof(uint64_t) &&
+               (size - header->image_size) % sizeof(uint64_t) == 0 &&
+               header->program >= sizeof(struct PROGRAM_CACHE_HEADER) &&
+               header->program + sizeof(struct STMT) <= header->image_size &&
+               header->source_hash == programcache_hash(PROGRAM_CACHE_HASH_SEED, source->begin, source->end) &&
+               header->checksum == programcache_hash(PROGRAM_CACHE_HASH_SEED, base + sizeof(*header), base + size);
+
+  const uint64_t* relocs = valid ? (const uint64_t*)(base + header->image_size) : NULL;
+  for (uint64_t i = 0; valid && i < header->num_relocs; i++) {
+    uint64_t field = relocs[i];
+    uintptr_t target;
+    if (field < sizeof(struct PROGRAM_CACHE_HEADER) || field % sizeof(uintptr_t) != 0 ||
+        field + sizeof(uintptr_t) > header->image_size) {
+      valid = false;
+      break;
+    }
+    memcpy(&target, base + field, sizeof(target));
+    if (target < sizeof(struct PROGRAM_CACHE_HEADER) || target >= header->image_size) {
+      valid = false;
+      break;
+    }
+    *(char**)(base + field) = base + target;
+  }
+
+  if (!valid) {
+    munmap(base, size);
+    return NULL;
+  }
+
+  cache->mapping = base;
+  cache->size = size;
+  cache->program = (struct STMT*)(base + header->program);
+  return cache->program;
+}
+
+
+//
+// programcache_close
+//
+void programcache_close(struct PROGRAM_CACHE* cache)
+{
+  if (cache->mapping != NULL) munmap(cache->mapping, cache->size);
+  cache->mapping = NULL;
+  cache->program = NULL;
+}
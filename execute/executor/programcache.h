@@ -0,0 +1,37 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "programgraph.h"
+#include "scanner.h"
+
+// A program graph loaded from a compiled cache file. The graph lives in the
+// file's private, writable mapping (execute_resolve still fills in addresses)
+// and stays valid until programcache_close.
+struct PROGRAM_CACHE {
+    void* mapping;
+    size_t size;
+    struct STMT* program;
+};
+
+// Returns the cache file name for the given script: name.py becomes
+// name.nupyc, and any other name gets .nupyc appended. The caller frees it.
+char* programcache_filename(const char* scriptname);
+
+// Loads the program graph cached for the given source (the whole mapped
+// script), or returns NULL if there is no cache file, or it is stale (the
+// source has changed since it was written), corrupt or from an incompatible
+// build; the caller should then parse the script as usual.
+struct STMT* programcache_load(const char* cachename, struct ScannerSource* source, struct PROGRAM_CACHE* cache);
+
+// Writes the program graph, as parsed from the given source and before
+// execute_resolve, to the cache file; the graph must have no deferred blocks.
+// Returns false if the file cannot be written.
+bool programcache_save(const char* cachename, struct ScannerSource* source, struct STMT* program);
+
+// Unmaps a graph loaded by programcache_load
+void programcache_close(struct PROGRAM_CACHE* cache);
+
+#endif // PROGRAMCACHE_H
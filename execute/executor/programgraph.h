@@ -1,26 +1,182 @@
 #ifndef PROGRAMGRAPH_H
 #define PROGRAMGRAPH_H
 
-#include "execute.h"
-
-struct PROGRAM_GRAPH_NODE {
-    struct STMT* statement;
-    struct PROGRAM_GRAPH_NODE* next;
-};
-
-// Function to create a new program graph node
-struct PROGRAM_GRAPH_NODE* create_program_graph_node(struct STMT* stmt) {
-    struct PROGRAM_GRAPH_NODE* new_node = malloc(sizeof(struct PROGRAM_GRAPH_NODE));
-    new_node->statement = stmt;
-    new_node->next = NULL;
-    return new_node;
-}
-
-// Function to add a node to the program graph
-void add_program_graph_node(struct PROGRAM_GRAPH_NODE** head, struct STMT* stmt) {
-    struct PROGRAM_GRAPH_NODE* new_node = create_program_graph_node(stmt);
-    new_node->next = *head;
-    *head = new_node;
-}
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "tokenqueue.h"
+#include "ram.h"
+
+// Statement types
+enum STMT_TYPES {
+    STMT_ASSIGNMENT,
+    STMT_FUNCTION_CALL,
+    STMT_IF_THEN_ELSE,
+    STMT_WHILE_LOOP,
+    STMT_PASS,
+    STMT_LAZY_BLOCK
+};
+
+// Define the structure for a statement; the union holds the statement-specific
+// data selected by stmt_type
+struct STMT {
+    int stmt_type;
+    int line;
+    union {
+        struct STMT_ASSIGNMENT* assignment;
+        struct STMT_FUNCTION_CALL* function_call;
+        struct STMT_IF_THEN_ELSE* if_then_else;
+        struct STMT_WHILE_LOOP* while_loop;
+        struct STMT_PASS* pass;
+        struct STMT_LAZY_BLOCK* lazy_block;
+    } types;
+};
+
+// var_name = rhs, where var_address is the RAM address bound to var_name
+// by execute_resolve
+struct STMT_ASSIGNMENT {
+    char* var_name;
+    int var_address;
+    bool isPtrDeref;
+    struct VALUE* rhs;
+    struct STMT* next_stmt;
+};
+
+// function_name(parameter), where parameter may be NULL
+struct STMT_FUNCTION_CALL {
+    char* function_name;
+    struct ELEMENT* parameter;
+    struct STMT* next_stmt;
+};
+
+// The last statement of each path links to next_stmt
+struct STMT_IF_THEN_ELSE {
+    struct EXPR* condition;
+    struct STMT* true_path;
+    struct STMT* false_path;
+    struct STMT* next_stmt;
+};
+
+// The last statement of loop_body links back to the while statement
+struct STMT_WHILE_LOOP {
+    struct EXPR* condition;
+    struct STMT* loop_body;
+    struct STMT* next_stmt;
+};
+
+struct STMT_PASS {
+    struct STMT* next_stmt;
+};
+
+// Stands in for a block (a loop body or an if/else path) whose statements
+// have not been built yet; see parser_parseProgramLazy. start is the position
+// of the block's '{' in the source's token queue, and referrer the field that
+// points at this statement, which is redirected to the block's first statement
+// once it is built. next_stmt is where the block continues, as for any path.
+struct STMT_LAZY_BLOCK {
+    struct LAZY_SOURCE* source;
+    int start;
+    struct STMT** referrer;
+    struct STMT* next_stmt;
+};
+
+// Value types for the right-hand side of an assignment
+enum VALUE_TYPES {
+    VALUE_FUNCTION_CALL,
+    VALUE_EXPR
+};
+
+struct VALUE {
+    int value_type;
+    union {
+        struct FUNCTION_CALL* function_call;
+        struct EXPR* expr;
+    } types;
+};
+
+struct FUNCTION_CALL {
+    char* function_name;
+    struct ELEMENT* parameter;
+};
+
+// Operators for binary expressions
+enum OPERATORS {
+    OPERATOR_NO_OP = -1,
+    OPERATOR_PLUS,
+    OPERATOR_MINUS,
+    OPERATOR_ASTERISK,
+    OPERATOR_POWER,
+    OPERATOR_MOD,
+    OPERATOR_DIV,
+    OPERATOR_EQUAL,
+    OPERATOR_NOT_EQUAL,
+    OPERATOR_LT,
+    OPERATOR_LTE,
+    OPERATOR_GT,
+    OPERATOR_GTE,
+    OPERATOR_IS,
+    OPERATOR_IN
+};
+
+// Computes lhs operator rhs for one combination of operand types, returning
+// false, and leaving result alone, if the operands are of other types
+typedef bool (*EXPR_HANDLER)(struct RAM_VALUE lhs, struct RAM_VALUE rhs, struct RAM_VALUE* result);
+
+// lhs [operator rhs]; rhs is NULL unless isBinaryExpr. quickened and misses
+// belong to the executor, which specializes each binary expression to the
+// operand types it sees there (see execute_expr); both start out zero.
+struct EXPR {
+    struct UNARY_EXPR* lhs;
+    bool isBinaryExpr;
+    int operator;
+    struct UNARY_EXPR* rhs;
+    EXPR_HANDLER quickened;
+    int misses;
+};
+
+enum UNARY_EXPR_TYPES {
+    UNARY_PTR_DEREF,
+    UNARY_ADDRESS_OF,
+    UNARY_PLUS,
+    UNARY_MINUS,
+    UNARY_ELEMENT
+};
+
+struct UNARY_EXPR {
+    int expr_type;
+    struct ELEMENT* element;
+};
+
+enum ELEMENT_TYPES {
+    ELEMENT_INT_LITERAL,
+    ELEMENT_REAL_LITERAL,
+    ELEMENT_STR_LITERAL,
+    ELEMENT_TRUE,
+    ELEMENT_FALSE,
+    ELEMENT_NONE,
+    ELEMENT_IDENTIFIER
+};
+
+// A literal or identifier; for identifiers, address is the RAM address
+// bound to element_value by execute_resolve. A literal's value is decoded
+// from its text when the graph is built (a string value is static, see
+// RAM_STR_STATIC, and lives with the graph); identifiers and None have no
+// value (RAM_TYPE_NONE). After execute_fold, a literal may also be the folded
+// result of an expression of two literals, whose text is only for display.
+struct ELEMENT {
+    int element_type;
+    char* element_value;
+    int address;
+    struct RAM_VALUE value;
+};
+
+// Builds the program graph from the given (valid) token queue
+struct STMT* programgraph_build(struct TokenQueue* tokens);
+
+// Frees the program graph
+void programgraph_destroy(struct STMT* program);
+
+// Prints the program graph to the console
+void programgraph_print(struct STMT* program);
 
 #endif // PROGRAMGRAPH_H
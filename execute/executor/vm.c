@@ -0,0 +1,651 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <assert.h>
+#include <math.h>
+
+#include "vm.h"
+#include "execute.h"
+#include "parser.h"
+
+// Opcodes, with what each does to registers (r), memory, constants and names
+enum VM_OPCODES {
+  VM_HALT,          // stop
+  VM_LOAD_CONST,    // r[a] = constants[b]
+  VM_LOAD_VAR,      // r[a] = memory[b], or report names[c] is not defined
+  VM_BINARY,        // r[a] = r[a] <operator c> r[b], for operators without their own opcode
+  VM_ADD,           // r[a] = r[a] + r[b]; as for the rest below, c is the operator
+  VM_SUB,           // r[a] = r[a] - r[b]
+  VM_MUL,           // r[a] = r[a] * r[b]
+  VM_POW,           // r[a] = r[a] ** r[b]
+  VM_MOD,           // r[a] = r[a] % r[b]
+  VM_DIV,           // r[a] = r[a] / r[b]
+  VM_EQ,            // r[a] = r[a] == r[b]
+  VM_NE,            // r[a] = r[a] != r[b]
+  VM_LT,            // r[a] = r[a] < r[b]
+  VM_LTE,           // r[a] = r[a] <= r[b]
+  VM_GT,            // r[a] = r[a] > r[b]
+  VM_GTE,           // r[a] = r[a] >= r[b]
+  VM_STORE,         // memory[b] = r[a]
+  VM_PRINT_CONST,   // print constants[b], a string already formatted for print
+  VM_PRINT_VAR,     // print memory[b], or report names[c] is not defined
+  VM_ASSIGN_CALL,   // run stmt, an assignment from a builtin call, in the executor
+  VM_JUMP,          // continue at a
+  VM_JUMP_UNLESS,   // continue at b unless r[a] is true
+  VM_BUILD          // build the deferred block stmt, compile it and continue there
+};
+
+static void compile_stmts(struct VM_PROGRAM* vm, struct STMT* stmt, struct STMT* stop);
+
+
+//
+// emit
+//
+// Appends an instruction to the code and returns its index.
+//
+static int emit(struct VM_PROGRAM* vm, int opcode, int a, int b, int c, struct STMT* stmt)
+{
+  if (vm->num_instrs == vm->code_capacity) {
+    vm->code_capacity *= 2;
+    vm->code = (struct VM_INSTR*)realloc(vm->code, vm->code_capacity * sizeof(struct VM_INSTR));
+  }
+
+  struct VM_INSTR* instr = &vm->code[vm->num_instrs];
+  instr->handler = NULL;
+  instr->opcode = opcode;
+  instr->a = a;
+  instr->b = b;
+  instr->c = c;
+  instr->stmt = stmt;
+  return vm->num_instrs++;
+}
+
+
+//
+// add_constant
+//
+// Adds a value to the constants, which takes over its string
+// reference if it has one, and returns its index.
+//
+static int add_constant(struct VM_PROGRAM* vm, struct RAM_VALUE value)
+{
+  if (vm->num_constants == vm->constant_capacity) {
+    vm->constant_capacity *= 2;
+    vm->constants = (struct RAM_VALUE*)realloc(vm->constants, vm->constant_capacity * sizeof(struct RAM_VALUE));
+  }
+
+  vm->constants[vm->num_constants] = value;
+  return vm->num_constants++;
+}
+
+
+//
+// add_text
+//
+// Formats a string constant, as printf would, and returns its index.
+//
+static int add_text(struct VM_PROGRAM* vm, const char* format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+
+  char* text = (char*)malloc(length + 1);
+  va_start(args, format);
+  vsnprintf(text, length + 1, format, args);
+  va_end(args);
+
+  struct RAM_VALUE value;
+  value.value_type = RAM_TYPE_STR;
+  value.types.str = ram_str_create(text, length);
+  free(text);
+  return add_constant(vm, value);
+}
+
+
+//
+// add_name
+//
+// Adds an identifier to the names and returns its index.
+//
+static int add_name(struct VM_PROGRAM* vm, char* name)
+{
+  if (vm->num_names == vm->name_capacity) {
+    vm->name_capacity *= 2;
+    vm->names = (char**)realloc(vm->names, vm->name_capacity * sizeof(char*));
+  }
+
+  vm->names[vm->num_names] = name;
+  return vm->num_names++;
+}
+
+
+//
+// use_registers
+//
+// Makes sure there are at least count registers.
+//
+static void use_registers(struct VM_PROGRAM* vm, int count)
+{
+  if (count <= vm->num_registers) return;
+
+  vm->registers = (struct RAM_VALUE*)realloc(vm->registers, count * sizeof(struct RAM_VALUE));
+  vm->num_registers = count;
+}
+
+
+//
+// compile_element
+//
+// Emits the code that loads a literal or variable into register reg.
+// A literal's value, decoded when the graph was built, becomes a
+// constant.
+//
+static void compile_element(struct VM_PROGRAM* vm, struct ELEMENT* element, int reg, struct STMT* stmt)
+{
+  if (element->element_type == ELEMENT_IDENTIFIER) {
+    emit(vm, VM_LOAD_VAR, reg, element->address, add_name(vm, element->element_value), stmt);
+    return;
+  }
+
+  assert(element->element_type != ELEMENT_NONE);
+  struct RAM_VALUE value = element->value;
+  if (value.value_type == RAM_TYPE_STR) ram_str_retain(value.types.str);
+  emit(vm, VM_LOAD_CONST, reg, add_constant(vm, value), 0, stmt);
+}
+
+
+//
+// binary_opcode
+//
+// Returns the opcode specialized for an operator, or VM_BINARY.
+//
+static int binary_opcode(int operator)
+{
+  switch (operator)
+  {
+    case OPERATOR_PLUS: return VM_ADD;
+    case OPERATOR_MINUS: return VM_SUB;
+    case OPERATOR_ASTERISK: return VM_MUL;
+    case OPERATOR_POWER: return VM_POW;
+    case OPERATOR_MOD: return VM_MOD;
+    case OPERATOR_DIV: return VM_DIV;
+    case OPERATOR_EQUAL: return VM_EQ;
+    case OPERATOR_NOT_EQUAL: return VM_NE;
+    case OPERATOR_LT: return VM_LT;
+    case OPERATOR_LTE: return VM_LTE;
+    case OPERATOR_GT: return VM_GT;
+    case OPERATOR_GTE: return VM_GTE;
+    default: return VM_BINARY;
+  }
+}
+
+
+//
+// compile_expr
+//
+// Emits the code that evaluates an expression of stmt into register
+// reg. Operands are loaded left to right into reg and reg + 1, so
+// evaluation stops at the same semantic error the executor would.
+//
+static void compile_expr(struct VM_PROGRAM* vm, struct EXPR* expr, int reg, struct STMT* stmt)
+{
+  assert(expr->lhs != NULL);
+  assert(expr->lhs->expr_type == UNARY_ELEMENT);
+  use_registers(vm, reg + 1);
+  compile_element(vm, expr->lhs->element, reg, stmt);
+  if (!expr->isBinaryExpr)
+    return;
+
+  assert(expr->operator != OPERATOR_NO_OP);  // we must have an operator
+  assert(expr->rhs->expr_type == UNARY_ELEMENT);
+  use_registers(vm, reg + 2);
+  compile_element(vm, expr->rhs->element, reg + 1, stmt);
+  emit(vm, binary_opcode(expr->operator), reg, reg + 1, expr->operator, stmt);
+}
+
+
+//
+// compile_print
+//
+// Emits the code for a call to print. A literal parameter is
+// formatted here, once, exactly as the executor prints it.
+//
+static void compile_print(struct VM_PROGRAM* vm, struct STMT* stmt)
+{
+  struct STMT_FUNCTION_CALL* call = stmt->types.function_call;
+  assert(strcmp(call->function_name, "print") == 0);
+
+  struct ELEMENT* parameter = call->parameter;
+  int text;
+  if (parameter == NULL)
+    text = add_text(vm, "\n");
+  else if (parameter->element_type == ELEMENT_STR_LITERAL)
+    text = add_text(vm, "%s\n", parameter->element_value);
+  else if (parameter->element_type == ELEMENT_INT_LITERAL)
+    text = add_text(vm, "%d\n", parameter->value.types.i);
+  else if (parameter->element_type == ELEMENT_REAL_LITERAL)
+    text = add_text(vm, "%lf\n", parameter->value.types.d);
+  else if (parameter->element_type == ELEMENT_TRUE || parameter->element_type == ELEMENT_FALSE)
+    text = add_text(vm, "%s\n", parameter->element_value);
+  else {
+    assert(parameter->element_type == ELEMENT_IDENTIFIER);
+    emit(vm, VM_PRINT_VAR, 0, parameter->address, add_name(vm, parameter->element_value), stmt);
+    return;
+  }
+
+  emit(vm, VM_PRINT_CONST, 0, text, 0, stmt);
+}
+
+
+//
+// compile_stmts
+//
+// Emits the code for every statement from stmt up to (but not
+// including) stop, which is where the code falls through to. As
+// in execute_resolve, a loop body stops at its while statement and
+// an if/else path at the statement after the if.
+//
+static void compile_stmts(struct VM_PROGRAM* vm, struct STMT* stmt, struct STMT* stop)
+{
+  while (stmt != NULL && stmt != stop) {
+    if (stmt->stmt_type == STMT_ASSIGNMENT) {
+      struct STMT_ASSIGNMENT* assign = stmt->types.assignment;
+      assert(assign->isPtrDeref == false);
+      if (assign->rhs->value_type == VALUE_EXPR) {
+        compile_expr(vm, assign->rhs->types.expr, 0, stmt);
+        emit(vm, VM_STORE, 0, assign->var_address, 0, stmt);
+      }
+      else {
+        assert(assign->rhs->value_type == VALUE_FUNCTION_CALL);
+        emit(vm, VM_ASSIGN_CALL, 0, 0, 0, stmt);
+      }
+      stmt = assign->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_FUNCTION_CALL) {
+      compile_print(vm, stmt);
+      stmt = stmt->types.function_call->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+      struct STMT_IF_THEN_ELSE* if_then_else = stmt->types.if_then_else;
+      compile_expr(vm, if_then_else->condition, 0, stmt);
+      int branch = emit(vm, VM_JUMP_UNLESS, 0, -1, 0, stmt);
+      compile_stmts(vm, if_then_else->true_path, if_then_else->next_stmt);
+      if (if_then_else->false_path != NULL) {
+        int skip = emit(vm, VM_JUMP, -1, 0, 0, stmt);
+        vm->code[branch].b = vm->num_instrs;
+        compile_stmts(vm, if_then_else->false_path, if_then_else->next_stmt);
+        vm->code[skip].a = vm->num_instrs;
+      }
+      else
+        vm->code[branch].b = vm->num_instrs;
+      stmt = if_then_else->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_WHILE_LOOP) {
+      struct STMT_WHILE_LOOP* while_loop = stmt->types.while_loop;
+      int top = vm->num_instrs;
+      compile_expr(vm, while_loop->condition, 0, stmt);
+      int done = emit(vm, VM_JUMP_UNLESS, 0, -1, 0, stmt);
+      compile_stmts(vm, while_loop->loop_body, stmt);
+      emit(vm, VM_JUMP, top, 0, 0, stmt);
+      vm->code[done].b = vm->num_instrs;
+      stmt = while_loop->next_stmt;
+    }
+    else if (stmt->stmt_type == STMT_LAZY_BLOCK) {
+      // not built yet; compiled when execution first gets there
+      emit(vm, VM_BUILD, 0, 0, 0, stmt);
+      stmt = stmt->types.lazy_block->next_stmt;
+    }
+    else {
+      assert(stmt->stmt_type == STMT_PASS);
+      stmt = stmt->types.pass->next_stmt;
+    }
+  }
+}
+
+
+//
+// vm_compile
+//
+// Given a program graph whose identifiers have been bound by
+// execute_resolve, compiles it to bytecode.
+//
+struct VM_PROGRAM* vm_compile(struct STMT* program)
+{
+  struct VM_PROGRAM* vm = (struct VM_PROGRAM*)malloc(sizeof(struct VM_PROGRAM));
+  vm->code_capacity = 64;
+  vm->code = (struct VM_INSTR*)malloc(vm->code_capacity * sizeof(struct VM_INSTR));
+  vm->num_instrs = 0;
+  vm->num_threaded = 0;
+  vm->constant_capacity = 16;
+  vm->constants = (struct RAM_VALUE*)malloc(vm->constant_capacity * sizeof(struct RAM_VALUE));
+  vm->num_constants = 0;
+  vm->name_capacity = 16;
+  vm->names = (char**)malloc(vm->name_capacity * sizeof(char*));
+  vm->num_names = 0;
+  vm->registers = NULL;
+  vm->num_registers = 0;
+
+  compile_stmts(vm, program, NULL);
+  emit(vm, VM_HALT, 0, 0, 0, NULL);
+  return vm;
+}
+
+
+//
+// release_values
+//
+// Drops the string references held by the first count values.
+//
+static void release_values(struct RAM_VALUE* values, int count)
+{
+  for (int i = 0; i < count; i++)
+    if (values[i].value_type == RAM_TYPE_STR) ram_str_release(values[i].types.str);
+}
+
+
+//
+// thread_code
+//
+// Points every instruction compiled since the last call at the
+// handler for its opcode.
+//
+static void thread_code(struct VM_PROGRAM* vm, const void* const* handlers)
+{
+  for (int i = vm->num_threaded; i < vm->num_instrs; i++)
+    vm->code[i].handler = handlers[vm->code[i].opcode];
+  vm->num_threaded = vm->num_instrs;
+}
+
+
+// Dispatch. With GCC or Clang, the code is direct-threaded: each
+// instruction holds the address of its handler (labels as values),
+// and every handler ends by jumping straight to the next one's.
+// Building with VM_SWITCH_DISPATCH defined, or with another compiler,
+// selects a switch in a loop instead. The handlers are the same.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(VM_SWITCH_DISPATCH)
+#define VM_THREADED
+#endif
+
+#ifdef VM_THREADED
+#define TARGET(opcode) case opcode: opcode##_handler:
+#define DISPATCH() goto *instr->handler
+#else
+#define TARGET(opcode) case opcode:
+#define DISPATCH() continue
+#endif
+
+// r[a] = r[a] op r[b], inline when both are ints or both reals; any
+// other operands (mixed, strings, errors) take the generic path
+#define ARITHMETIC(op)                                                        \
+  {                                                                           \
+    struct RAM_VALUE* lhs = &r[instr->a];                                     \
+    struct RAM_VALUE* rhs = &r[instr->b];                                     \
+    if (lhs->value_type == RAM_TYPE_INT && rhs->value_type == RAM_TYPE_INT)   \
+      lhs->types.i = lhs->types.i op rhs->types.i;                            \
+    else if (lhs->value_type == RAM_TYPE_REAL && rhs->value_type == RAM_TYPE_REAL) \
+      lhs->types.d = lhs->types.d op rhs->types.d;                            \
+    else                                                                      \
+      goto binary;                                                            \
+    instr++;                                                                  \
+    DISPATCH();                                                               \
+  }
+
+// r[a] = r[a] op r[b] as a boolean, inline when both are ints or both
+// reals, otherwise by the generic path
+#define COMPARISON(op)                                                        \
+  {                                                                           \
+    struct RAM_VALUE* lhs = &r[instr->a];                                     \
+    struct RAM_VALUE* rhs = &r[instr->b];                                     \
+    int result;                                                               \
+    if (lhs->value_type == RAM_TYPE_INT && rhs->value_type == RAM_TYPE_INT)   \
+      result = lhs->types.i op rhs->types.i;                                  \
+    else if (lhs->value_type == RAM_TYPE_REAL && rhs->value_type == RAM_TYPE_REAL) \
+      result = lhs->types.d op rhs->types.d;                                  \
+    else                                                                      \
+      goto binary;                                                            \
+    lhs->value_type = RAM_TYPE_BOOLEAN;                                       \
+    lhs->types.i = result;                                                    \
+    instr++;                                                                  \
+    DISPATCH();                                                               \
+  }
+
+
+//
+// vm_run
+//
+// Runs the bytecode until it halts or a semantic error stops it.
+// A register holds a string reference from the load that fills it
+// until the instruction that consumes it, so when execution stops
+// only the registers below a failed load still need releasing.
+//
+void vm_run(struct VM_PROGRAM* vm, struct RAM* memory)
+{
+#ifdef VM_THREADED
+  static const void* const handlers[] = {
+    [VM_HALT] = &&VM_HALT_handler,
+    [VM_LOAD_CONST] = &&VM_LOAD_CONST_handler,
+    [VM_LOAD_VAR] = &&VM_LOAD_VAR_handler,
+    [VM_BINARY] = &&VM_BINARY_handler,
+    [VM_ADD] = &&VM_ADD_handler,
+    [VM_SUB] = &&VM_SUB_handler,
+    [VM_MUL] = &&VM_MUL_handler,
+    [VM_POW] = &&VM_POW_handler,
+    [VM_MOD] = &&VM_MOD_handler,
+    [VM_DIV] = &&VM_DIV_handler,
+    [VM_EQ] = &&VM_EQ_handler,
+    [VM_NE] = &&VM_NE_handler,
+    [VM_LT] = &&VM_LT_handler,
+    [VM_LTE] = &&VM_LTE_handler,
+    [VM_GT] = &&VM_GT_handler,
+    [VM_GTE] = &&VM_GTE_handler,
+    [VM_STORE] = &&VM_STORE_handler,
+    [VM_PRINT_CONST] = &&VM_PRINT_CONST_handler,
+    [VM_PRINT_VAR] = &&VM_PRINT_VAR_handler,
+    [VM_ASSIGN_CALL] = &&VM_ASSIGN_CALL_handler,
+    [VM_JUMP] = &&VM_JUMP_handler,
+    [VM_JUMP_UNLESS] = &&VM_JUMP_UNLESS_handler,
+    [VM_BUILD] = &&VM_BUILD_handler
+  };
+  thread_code(vm, handlers);
+#endif
+
+  struct RAM_VALUE* r = vm->registers;
+  struct VM_INSTR* instr = vm->code;
+
+  for (;;) {
+#ifdef VM_THREADED
+    DISPATCH();
+#endif
+    switch (instr->opcode) {
+      TARGET(VM_HALT)
+        return;
+
+      TARGET(VM_LOAD_CONST)
+        r[instr->a] = vm->constants[instr->b];
+        if (r[instr->a].value_type == RAM_TYPE_STR) ram_str_retain(r[instr->a].types.str);
+        instr++;
+        DISPATCH();
+
+      TARGET(VM_LOAD_VAR) {
+        struct RAM_VALUE value;  // borrowed from memory, no copy is made
+        if (!ram_peek_cell_by_addr(memory, instr->b, &value)) {
+          printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", vm->names[instr->c], instr->stmt->line);
+          release_values(r, instr->a);
+          return;
+        }
+        if (value.value_type == RAM_TYPE_STR)
+          ram_str_retain(value.types.str);
+        else if (value.value_type != RAM_TYPE_INT && value.value_type != RAM_TYPE_BOOLEAN && value.value_type != RAM_TYPE_REAL) {
+          release_values(r, instr->a);
+          return;
+        }
+        r[instr->a] = value;
+        instr++;
+        DISPATCH();
+      }
+
+      TARGET(VM_ADD)
+        ARITHMETIC(+)
+
+      TARGET(VM_SUB)
+        ARITHMETIC(-)
+
+      TARGET(VM_MUL)
+        ARITHMETIC(*)
+
+      TARGET(VM_DIV)
+        ARITHMETIC(/)
+
+      TARGET(VM_POW) {
+        struct RAM_VALUE* lhs = &r[instr->a];
+        struct RAM_VALUE* rhs = &r[instr->b];
+        if (lhs->value_type == RAM_TYPE_INT && rhs->value_type == RAM_TYPE_INT)
+          lhs->types.i = (int) pow(lhs->types.i, rhs->types.i);
+        else if (lhs->value_type == RAM_TYPE_REAL && rhs->value_type == RAM_TYPE_REAL)
+          lhs->types.d = pow(lhs->types.d, rhs->types.d);
+        else
+          goto binary;
+        instr++;
+        DISPATCH();
+      }
+
+      TARGET(VM_MOD) {
+        struct RAM_VALUE* lhs = &r[instr->a];
+        struct RAM_VALUE* rhs = &r[instr->b];
+        if (lhs->value_type == RAM_TYPE_INT && rhs->value_type == RAM_TYPE_INT)
+          lhs->types.i = lhs->types.i % rhs->types.i;
+        else if (lhs->value_type == RAM_TYPE_REAL && rhs->value_type == RAM_TYPE_REAL)
+          lhs->types.d = fmod(lhs->types.d, rhs->types.d);
+        else
+          goto binary;
+        instr++;
+        DISPATCH();
+      }
+
+      TARGET(VM_EQ)
+        COMPARISON(==)
+
+      TARGET(VM_NE)
+        COMPARISON(!=)
+
+      TARGET(VM_LT)
+        COMPARISON(<)
+
+      TARGET(VM_LTE)
+        COMPARISON(<=)
+
+      TARGET(VM_GT)
+        COMPARISON(>)
+
+      TARGET(VM_GTE)
+        COMPARISON(>=)
+
+      TARGET(VM_BINARY)
+      binary: {
+        bool success = true;
+        struct RAM_VALUE result = execute_operator(r[instr->a], instr->c, r[instr->b], instr->stmt, &success);
+        release_values(r + instr->a, 1);
+        release_values(r + instr->b, 1);
+        if (!success)
+          return;
+        r[instr->a] = result;
+        instr++;
+        DISPATCH();
+      }
+
+      TARGET(VM_STORE) {
+        bool success = ram_write_cell_by_addr(memory, r[instr->a], instr->b);
+        release_values(r + instr->a, 1);  // memory holds its own reference now
+        if (!success)
+          return;
+        instr++;
+        DISPATCH();
+      }
+
+      TARGET(VM_PRINT_CONST)
+        fputs(vm->constants[instr->b].types.str->chars, stdout);
+        instr++;
+        DISPATCH();
+
+      TARGET(VM_PRINT_VAR) {
+        struct RAM_VALUE value;
+        if (!ram_peek_cell_by_addr(memory, instr->b, &value)) {
+          printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", vm->names[instr->c], instr->stmt->line);
+          return;
+        }
+        if (value.value_type == RAM_TYPE_INT) printf("%d\n", value.types.i);
+        else if (value.value_type == RAM_TYPE_REAL) printf("%lf\n", value.types.d);
+        else if (value.value_type == RAM_TYPE_STR) printf("%s\n", value.types.str->chars);
+        else if (value.value_type == RAM_TYPE_BOOLEAN && value.types.i == 1) printf("True\n");
+        else if (value.value_type == RAM_TYPE_BOOLEAN && value.types.i == 0) printf("False\n");
+        instr++;
+        DISPATCH();
+      }
+
+      TARGET(VM_ASSIGN_CALL)
+        if (!execute_assignment(instr->stmt, memory))
+          return;
+        instr++;
+        DISPATCH();
+
+      TARGET(VM_JUMP)
+        instr = vm->code + instr->a;
+        DISPATCH();
+
+      TARGET(VM_JUMP_UNLESS) {
+        bool is_true = r[instr->a].types.i == 1;
+        release_values(r + instr->a, 1);
+        instr = is_true ? instr + 1 : vm->code + instr->b;
+        DISPATCH();
+      }
+
+      TARGET(VM_BUILD) {
+        // first time here: build the block and compile it onto the
+        // end of the code, then jump back to the code that follows,
+        // which is where the block continues
+        int pc = (int)(instr - vm->code);
+        struct STMT* next_stmt = instr->stmt->types.lazy_block->next_stmt;
+        struct STMT* block = execute_build_block(instr->stmt, memory);
+
+        int start = vm->num_instrs;
+        compile_stmts(vm, block, next_stmt);
+        emit(vm, VM_JUMP, pc + 1, 0, 0, NULL);
+        vm->code[pc].opcode = VM_JUMP;  // the code may have moved
+        vm->code[pc].a = start;
+#ifdef VM_THREADED
+        vm->code[pc].handler = handlers[VM_JUMP];
+        thread_code(vm, handlers);
+#endif
+        r = vm->registers;
+        instr = vm->code + start;
+        DISPATCH();
+      }
+
+      default:
+        printf("**INTERNAL ERROR: unexpected opcode (%d) in vm_run\n", instr->opcode);
+        assert(false);
+        return;
+    }
+  }
+}
+
+
+//
+// vm_destroy
+//
+// Frees the bytecode, its constants and its registers.
+//
+void vm_destroy(struct VM_PROGRAM* vm)
+{
+  if (vm == NULL) return;
+
+  release_values(vm->constants, vm->num_constants);
+  free(vm->constants);
+  free(vm->code);
+  free(vm->names);
+  free(vm->registers);
+  free(vm);
+}
@@ -0,0 +1,53 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdbool.h>
+
+#include "programgraph.h"
+#include "ram.h"
+
+// One bytecode instruction. Its operands (registers, RAM addresses, constant
+// and name indices, or jump targets) depend on the opcode; see vm.c. stmt is
+// the statement the instruction was compiled from, for the line number of a
+// semantic error and for the statements the VM hands back to the executor.
+// handler is the address of the opcode's handler in vm_run once the code
+// has been threaded, and unused with switch dispatch.
+struct VM_INSTR {
+    const void* handler;
+    int opcode;
+    int a;
+    int b;
+    int c;
+    struct STMT* stmt;
+};
+
+// A program graph compiled to linear bytecode. Temporaries live in registers,
+// variables stay in RAM at the addresses execute_resolve bound them to, and
+// literals are decoded once into the constants. Deferred blocks are compiled
+// when execution first reaches them, and their code is appended to code.
+struct VM_PROGRAM {
+    struct VM_INSTR* code;
+    int num_instrs;
+    int code_capacity;
+    int num_threaded;          // instructions whose handler is set
+    struct RAM_VALUE* constants;
+    int num_constants;
+    int constant_capacity;
+    char** names;              // identifiers, for "not defined" errors
+    int num_names;
+    int name_capacity;
+    struct RAM_VALUE* registers;
+    int num_registers;
+};
+
+// Compiles a resolved program graph (see execute_resolve) to bytecode
+struct VM_PROGRAM* vm_compile(struct STMT* program);
+
+// Runs compiled bytecode against the given memory; the output, semantic errors
+// and memory contents are the same as execute would produce for the graph.
+void vm_run(struct VM_PROGRAM* vm, struct RAM* memory);
+
+// Frees compiled bytecode and its constants
+void vm_destroy(struct VM_PROGRAM* vm);
+
+#endif // VM_H
@@ -17,17 +17,28 @@ struct RESULT {
     int result;
 };
 
+//
+// Returns the integer a literal element stands for: an int
+// literal's value, decoded when the graph was built, or for
+// any other element atoi of its text, as it always has been.
+//
+static int literal_int(struct ELEMENT* element) {
+  if (element->element_type == ELEMENT_INT_LITERAL) return element->value.types.i;
+  return atoi(element->element_value);
+}
+
 //
 // Retrieves an integer representing the value specified
 //
 int retrieve_value(struct UNARY_EXPR* value, struct RAM* memory) {
   // if value isn't in memory (check one at a time), return -1
+  struct RAM_VALUE ram_value;  // borrowed from memory, no copy is made
   if (value->element->element_type == ELEMENT_IDENTIFIER &&
-      ram_read_cell_by_name(memory, value->element->element_value) == NULL) return -1;
-  else if (value->element->element_type == ELEMENT_IDENTIFIER) return ram_read_cell_by_name(memory, value->element->element_value)->types.i;
+      !ram_peek_cell_by_name(memory, value->element->element_value, &ram_value)) return -1;
+  else if (value->element->element_type == ELEMENT_IDENTIFIER) return ram_value.types.i;
   // else if the element is an identifier, get its value
   // return as an integer
-  return atoi(value->element->element_value);
+  return literal_int(value->element);
 }
 
 //
@@ -74,16 +85,17 @@ bool execute_function_call(struct STMT* statement, struct RAM* memory) {
   }
   char* param = statement->types.function_call->parameter->element_value;
   if (statement->types.function_call->parameter->element_type == ELEMENT_INT_LITERAL) {
-    int int_literal = atoi(param);
+    int int_literal = literal_int(statement->types.function_call->parameter);
     printf("%d\n", int_literal);
     return true;
   }
   else if (statement->types.function_call->parameter->element_type == ELEMENT_IDENTIFIER) {
-    if (ram_read_cell_by_name(memory, statement->types.function_call->parameter->element_value) == NULL) {
+    struct RAM_VALUE ram_value;
+    if (!ram_peek_cell_by_name(memory, statement->types.function_call->parameter->element_value, &ram_value)) {
       printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", statement->types.function_call->parameter->element_value, statement->line);
       return false;
     }
-    int num = ram_read_cell_by_name(memory, statement->types.function_call->parameter->element_value)->types.i;
+    int num = ram_value.types.i;
     printf("%d\n", num);
     return true;
   }
@@ -99,8 +111,9 @@ bool execute_function_call(struct STMT* statement, struct RAM* memory) {
 //
 bool execute_assignment(struct STMT* statement, struct RAM* memory) {
   // Check if it's an identifier first
+  struct RAM_VALUE ram_value;
   if (statement->types.assignment->rhs->types.expr->lhs->element->element_type == ELEMENT_IDENTIFIER &&
-      ram_read_cell_by_name(memory, statement->types.assignment->rhs->types.expr->lhs->element->element_value) == NULL) {
+      !ram_peek_cell_by_name(memory, statement->types.assignment->rhs->types.expr->lhs->element->element_value, &ram_value)) {
       printf("**SEMANTIC ERROR: name '%s' is not defined (line %d)\n", statement->types.assignment->rhs->types.expr->lhs->element->element_value, statement->line);
       return false;
   }
@@ -119,8 +132,8 @@ bool execute_assignment(struct STMT* statement, struct RAM* memory) {
     value.types.i = temp.result;
   }
   else {
-    char* literal = statement->types.assignment->rhs->types.expr->lhs->element->element_value;
-    value.types.i = atoi(literal);
+    struct ELEMENT* literal = statement->types.assignment->rhs->types.expr->lhs->element;
+    value.types.i = literal_int(literal);
   }
   ram_write_cell_by_name(memory, value, statement->types.assignment->var_name);
   return true;
@@ -16,11 +16,13 @@
 // main
 // 
 // If a filename is given, the file is opened and serves as
-// input to the program. If a filename is not given, then 
+// input to the program; it is mapped into memory and
+// scanned in place. If a filename is not given, then 
 // input is taken from the keyboard until $ is input.
 //
 int main(int argc, char* argv[]) {
   FILE* input = NULL;
+  struct ScannerSource source;
   bool  keyboardInput = false;
 
   if (argc < 2) {
@@ -30,9 +32,7 @@ int main(int argc, char* argv[]) {
   else {
     char* filename = argv[1];
 
-    input = fopen(filename, "r");
-
-    if (input == NULL) {
+    if (!scanner_openFile(&source, filename)) {
       printf("**ERROR: unable to open input file '%s' for input.\n", filename);
       return 0;
     }
@@ -43,25 +43,25 @@ int main(int argc, char* argv[]) {
   if (keyboardInput) {
     printf("nuPython input (enter $ when you're done)>\n");
   }
-  struct TokenQueue* tokens = parser_parse(input);
-  if (tokens == NULL) {
+  struct ARENA* arena = arena_init();
+  struct STMT* program = keyboardInput ? parser_parseProgram(input, arena) : parser_parseProgramSource(&source, arena);
+  if (program == NULL) {
     printf("**parsing failed...\n");
   }
   else {
     printf("**parsing successful, valid syntax\n");
     printf("**building program graph...\n");
-    struct STMT* program = programgraph_build(tokens);
     programgraph_print(program);
     printf("**executing...\n");
     struct RAM* memory = ram_init();
     execute(program, memory);
     printf("**done\n");
     ram_print(memory);
-    tokenqueue_destroy(tokens);
   }
+  arena_destroy(arena);
 
   if (!keyboardInput)
-    fclose(input);
+    scanner_close(&source);
 
   return 0;
 }
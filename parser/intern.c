@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+
+#define INTERN_INITIAL_CAPACITY 256
+
+//
+// internHash
+//
+// Returns the FNV-1a hash of the given text.
+//
+static unsigned int internHash(const char* start, int length) {
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash ^= (unsigned char)start[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+//
+// intern_init
+//
+// Returns a new, empty intern table whose strings will be
+// allocated from the given arena.
+//
+struct INTERN_TABLE* intern_init(struct ARENA* arena) {
+    struct INTERN_TABLE* table = (struct INTERN_TABLE*)malloc(sizeof(struct INTERN_TABLE));
+    table->arena = arena;
+    table->num_strings = 0;
+    table->capacity = INTERN_INITIAL_CAPACITY;
+    table->strings = (char**)calloc(table->capacity, sizeof(char*));
+    table->hashes = (unsigned int*)malloc(table->capacity * sizeof(unsigned int));
+    table->lengths = (int*)malloc(table->capacity * sizeof(int));
+    return table;
+}
+
+//
+// intern_destroy
+//
+// Frees the table's index; the interned strings stay valid
+// until the arena is destroyed.
+//
+void intern_destroy(struct INTERN_TABLE* table) {
+    if (table == NULL) return;
+    free(table->strings);
+    free(table->hashes);
+    free(table->lengths);
+    free(table);
+}
+
+//
+// internGrow
+//
+// Doubles the index, reinserting each string by its stored
+// hash.
+//
+static void internGrow(struct INTERN_TABLE* table) {
+    int capacity = table->capacity * 2;
+    char** strings = (char**)calloc(capacity, sizeof(char*));
+    unsigned int* hashes = (unsigned int*)malloc(capacity * sizeof(unsigned int));
+    int* lengths = (int*)malloc(capacity * sizeof(int));
+
+    for (int i = 0; i < table->capacity; i++) {
+        if (table->strings[i] == NULL) continue;
+        int slot = (int)(table->hashes[i] & (unsigned int)(capacity - 1));
+        while (strings[slot] != NULL) slot = (slot + 1) & (capacity - 1);
+        strings[slot] = table->strings[i];
+        hashes[slot] = table->hashes[i];
+        lengths[slot] = table->lengths[i];
+    }
+
+    free(table->strings);
+    free(table->hashes);
+    free(table->lengths);
+    table->strings = strings;
+    table->hashes = hashes;
+    table->lengths = lengths;
+    table->capacity = capacity;
+}
+
+//
+// intern_span
+//
+// Returns the interned copy of the given text (length
+// characters, not NUL-terminated), adding it to the table
+// the first time it is seen.
+//
+char* intern_span(struct INTERN_TABLE* table, const char* start, int length) {
+    unsigned int hash = internHash(start, length);
+    int mask = table->capacity - 1;
+    int slot = (int)(hash & (unsigned int)mask);
+
+    // linear probing; the index is kept at most half full
+    while (table->strings[slot] != NULL) {
+        if (table->hashes[slot] == hash && table->lengths[slot] == length &&
+            memcmp(table->strings[slot], start, length) == 0)
+            return table->strings[slot];
+        slot = (slot + 1) & mask;
+    }
+
+    char* copy = (char*)arena_alloc(table->arena, length + 1);
+    memcpy(copy, start, length);
+    copy[length] = '\0';
+
+    table->strings[slot] = copy;
+    table->hashes[slot] = hash;
+    table->lengths[slot] = length;
+    table->num_strings++;
+    if (table->num_strings * 2 > table->capacity) internGrow(table);
+    return copy;
+}
+
+//
+// intern_string
+//
+// Same as intern_span, for a NUL-terminated string.
+//
+char* intern_string(struct INTERN_TABLE* table, const char* s) {
+    return intern_span(table, s, (int)strlen(s));
+}
@@ -0,0 +1,26 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include "arena.h"
+
+// Define the INTERN_TABLE structure, which keeps one copy of each distinct
+// string (identifier or literal text) in an arena. Interning the same text
+// twice returns the same pointer, so interned strings can be compared by
+// address. The strings live as long as the arena; the table itself is only
+// the index over them and can be destroyed as soon as interning is done.
+struct INTERN_TABLE {
+    struct ARENA* arena;
+    char** strings;        // open-addressing index, NULL for an empty slot
+    unsigned int* hashes;  // hash of the string in each slot
+    int* lengths;          // and its length
+    int num_strings;
+    int capacity;          // always a power of 2
+};
+
+// Function declarations for intern.c
+struct INTERN_TABLE* intern_init(struct ARENA* arena);
+void intern_destroy(struct INTERN_TABLE* table);
+char* intern_span(struct INTERN_TABLE* table, const char* start, int length);
+char* intern_string(struct INTERN_TABLE* table, const char* s);
+
+#endif // INTERN_H
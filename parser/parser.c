@@ -1,96 +1,284 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <assert.h>
 
+#include <unistd.h>
+
 #include "scanner.h"
 #include "parser.h"
+#include "intern.h"
+
+// sources at least this large are scanned on all cores, if there is more than
+// one; see scanner_scanParallel
+#define PARALLEL_SCAN_MIN_BYTES (1 << 20)
 
 static void printSyntaxError(char* expected, char* actual, struct Token foundToken);
-static bool verifyToken(struct TokenQueue* tokens, int expectedID, char* expectedValue);
+static bool verifyToken(struct TokenCursor* tokens, int expectedID, char* expectedValue);
+
+static bool parseExpression(struct TokenCursor* tokens, struct ARENA* arena, struct EXPR** expr);
+static bool parseBlock(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** body);
+static bool buildBlock(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** body);
+static bool deferBlock(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** body);
+static bool parseElse(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** stmt);
+
+static bool parseIfElse(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** stmt);
+static bool parsePass(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** stmt);
+static bool parseEmpty(struct TokenCursor* tokens, struct STMT** stmt);
+static bool isStatementStart(struct TokenCursor* tokens);
+static bool parseStatement(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** stmt);
+static bool parseStatementList(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** head, struct STMT** tail);
+static bool parseProgram(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** program);
+
+//
+// The parse functions build the program graph as they go,
+// handing each node back through their last parameter. All
+// nodes are allocated from the arena, and names and literal
+// values are interned there, so each distinct one is stored
+// once; a graph left half-built by a syntax error needs no
+// cleanup of its own.
+//
+static void* newNode(struct ARENA* arena, size_t size) {
+    void* node = arena_alloc(arena, size);
+    memset(node, 0, size);
+    return node;
+}
 
-static bool parseExpression(struct TokenQueue* tokens);
-static bool parseBlock(struct TokenQueue* tokens);
-static bool parseElse(struct TokenQueue* tokens);
+static struct STMT* newStmt(struct ARENA* arena, int stmtType, int line) {
+    struct STMT* stmt = (struct STMT*)newNode(arena, sizeof(struct STMT));
+    stmt->stmt_type = stmtType;
+    stmt->line = line;
+    if (stmtType == STMT_ASSIGNMENT) {
+        stmt->types.assignment = (struct STMT_ASSIGNMENT*)newNode(arena, sizeof(struct STMT_ASSIGNMENT));
+        stmt->types.assignment->var_address = -1;
+    }
+    else if (stmtType == STMT_FUNCTION_CALL)
+        stmt->types.function_call = (struct STMT_FUNCTION_CALL*)newNode(arena, sizeof(struct STMT_FUNCTION_CALL));
+    else if (stmtType == STMT_IF_THEN_ELSE)
+        stmt->types.if_then_else = (struct STMT_IF_THEN_ELSE*)newNode(arena, sizeof(struct STMT_IF_THEN_ELSE));
+    else if (stmtType == STMT_WHILE_LOOP)
+        stmt->types.while_loop = (struct STMT_WHILE_LOOP*)newNode(arena, sizeof(struct STMT_WHILE_LOOP));
+    else if (stmtType == STMT_LAZY_BLOCK)
+        stmt->types.lazy_block = (struct STMT_LAZY_BLOCK*)newNode(arena, sizeof(struct STMT_LAZY_BLOCK));
+    else
+        stmt->types.pass = (struct STMT_PASS*)newNode(arena, sizeof(struct STMT_PASS));
+    return stmt;
+}
 
-static bool parseIfElse(struct TokenQueue* tokens);
-static bool parsePass(struct TokenQueue* tokens);
-static bool parseEmpty(struct TokenQueue* tokens);
-static bool isStatementStart(struct TokenQueue* tokens);
-static bool parseStatement(struct TokenQueue* tokens);
-static bool parseStatementList(struct TokenQueue* tokens);
-static bool parseProgram(struct TokenQueue* tokens);
+//
+// nextOf
+//
+// Returns where the statement keeps its next_stmt.
+//
+static struct STMT** nextOf(struct STMT* stmt) {
+    if (stmt->stmt_type == STMT_ASSIGNMENT) return &stmt->types.assignment->next_stmt;
+    if (stmt->stmt_type == STMT_FUNCTION_CALL) return &stmt->types.function_call->next_stmt;
+    if (stmt->stmt_type == STMT_IF_THEN_ELSE) return &stmt->types.if_then_else->next_stmt;
+    if (stmt->stmt_type == STMT_WHILE_LOOP) return &stmt->types.while_loop->next_stmt;
+    if (stmt->stmt_type == STMT_LAZY_BLOCK) return &stmt->types.lazy_block->next_stmt;
+    return &stmt->types.pass->next_stmt;
+}
+
+//
+// lastStmt
+//
+// Returns the last statement of a path whose end has not
+// been linked yet.
+//
+static struct STMT* lastStmt(struct STMT* stmt) {
+    while (*nextOf(stmt) != NULL) stmt = *nextOf(stmt);
+    return stmt;
+}
+
+//
+// linkStmt
+//
+// Links the statement to whatever runs after it: an if/else
+// continues at next from the end of either path as well as
+// when no path is taken.
+//
+static void linkStmt(struct STMT* stmt, struct STMT* next) {
+    *nextOf(stmt) = next;
+    if (stmt->stmt_type == STMT_IF_THEN_ELSE) {
+        struct STMT_IF_THEN_ELSE* ifThenElse = stmt->types.if_then_else;
+        linkStmt(lastStmt(ifThenElse->true_path), next);
+        if (ifThenElse->false_path != NULL) linkStmt(lastStmt(ifThenElse->false_path), next);
+    }
+}
+
+static int elementType(int tokenID) {
+    switch (tokenID) {
+        case nuPy_IDENTIFIER: return ELEMENT_IDENTIFIER;
+        case nuPy_INT_LITERAL: return ELEMENT_INT_LITERAL;
+        case nuPy_REAL_LITERAL: return ELEMENT_REAL_LITERAL;
+        case nuPy_STR_LITERAL: return ELEMENT_STR_LITERAL;
+        case nuPy_KEYW_TRUE: return ELEMENT_TRUE;
+        case nuPy_KEYW_FALSE: return ELEMENT_FALSE;
+        case nuPy_KEYW_NONE: return ELEMENT_NONE;
+        default: return -1;
+    }
+}
+
+static int operatorType(int tokenID) {
+    switch (tokenID) {
+        case nuPy_PLUS: return OPERATOR_PLUS;
+        case nuPy_MINUS: return OPERATOR_MINUS;
+        case nuPy_ASTERISK: return OPERATOR_ASTERISK;
+        case nuPy_POWER: return OPERATOR_POWER;
+        case nuPy_PERCENT: return OPERATOR_MOD;
+        case nuPy_SLASH: return OPERATOR_DIV;
+        case nuPy_EQUALEQUAL: return OPERATOR_EQUAL;
+        case nuPy_NOTEQUAL: return OPERATOR_NOT_EQUAL;
+        case nuPy_LT: return OPERATOR_LT;
+        case nuPy_LTE: return OPERATOR_LTE;
+        case nuPy_GT: return OPERATOR_GT;
+        case nuPy_GTE: return OPERATOR_GTE;
+        case nuPy_KEYW_IS: return OPERATOR_IS;
+        case nuPy_KEYW_IN: return OPERATOR_IN;
+        default: return OPERATOR_NO_OP;
+    }
+}
 
 static void printSyntaxError(char* expected, char* actual, struct Token foundToken) {
     printf("**SYNTAX ERROR @ (%d,%d): expected %s, found '%s'\n", foundToken.line, foundToken.col, expected, actual);
 }
 
-static bool verifyToken(struct TokenQueue* tokens, int expectedID, char* expectedValue) {
-    struct Token curToken = tokenqueue_peekToken(tokens);
+static bool verifyToken(struct TokenCursor* tokens, int expectedID, char* expectedValue) {
+    struct Token curToken = tokencursor_peek(tokens);
     if (curToken.id != expectedID) {
-        printSyntaxError(expectedValue, tokenqueue_peekValue(tokens), curToken);
+        printSyntaxError(expectedValue, tokencursor_value(tokens), curToken);
         return false;
     }
-    tokenqueue_dequeue(tokens);
+    tokencursor_advance(tokens);
     return true;
 }
 
-static bool parseElement(struct TokenQueue* tokens) {
-    struct Token curToken = tokenqueue_peekToken(tokens);
-    if (curToken.id == nuPy_IDENTIFIER || curToken.id == nuPy_INT_LITERAL || 
-        curToken.id == nuPy_REAL_LITERAL || curToken.id == nuPy_STR_LITERAL || 
-        curToken.id == nuPy_KEYW_TRUE || curToken.id == nuPy_KEYW_FALSE || 
-        curToken.id == nuPy_KEYW_NONE) {
-        tokenqueue_dequeue(tokens);
-        return true;
+// The value of the token at the cursor for a node: interned,
+// unless the cursor is only checking the syntax
+static char* nodeValue(struct TokenCursor* tokens) {
+    return tokens->interns != NULL ? tokencursor_intern(tokens) : tokencursor_value(tokens);
+}
+
+// verifyToken for an IDENTIFIER, keeping its name
+static bool verifyIdentifier(struct TokenCursor* tokens, char** name) {
+    if (tokencursor_peek(tokens).id == nuPy_IDENTIFIER) *name = nodeValue(tokens);
+    return verifyToken(tokens, nuPy_IDENTIFIER, "IDENTIFIER");
+}
+
+//
+// staticString
+//
+// Allocates a string value of the given length in the arena,
+// for the caller to fill in. It is marked static, so retaining
+// and releasing it do nothing, and it lives as long as the
+// graph does.
+//
+static struct RAM_STR* staticString(struct ARENA* arena, int length) {
+    struct RAM_STR* str = (struct RAM_STR*)arena_alloc(arena, sizeof(struct RAM_STR) + length + 1);
+    str->refcount = RAM_STR_STATIC;
+    str->length = length;
+    str->chars[length] = '\0';
+    return str;
+}
+
+//
+// decodeLiteral
+//
+// Decodes a literal's text into its value, once, so nothing
+// that runs the graph has to parse literals again. Identifiers
+// and None have no value (RAM_TYPE_NONE).
+//
+static void decodeLiteral(struct ARENA* arena, struct ELEMENT* element) {
+    struct RAM_VALUE* value = &element->value;
+    char* text = element->element_value;
+    switch (element->element_type) {
+        case ELEMENT_INT_LITERAL:
+            value->value_type = RAM_TYPE_INT;
+            value->types.i = atoi(text);
+            break;
+        case ELEMENT_REAL_LITERAL:
+            value->value_type = RAM_TYPE_REAL;
+            value->types.d = atof(text);
+            break;
+        case ELEMENT_STR_LITERAL:
+            value->value_type = RAM_TYPE_STR;
+            value->types.str = staticString(arena, (int)strlen(text));
+            memcpy(value->types.str->chars, text, value->types.str->length);
+            break;
+        case ELEMENT_TRUE:
+        case ELEMENT_FALSE:
+            value->value_type = RAM_TYPE_BOOLEAN;
+            value->types.i = strcmp(text, "True") == 0;
+            break;
+        default:
+            value->value_type = RAM_TYPE_NONE;
+            break;
     }
-    return false;
 }
 
-static bool parseUnaryExpression(struct TokenQueue* tokens) {
-    struct Token curToken = tokenqueue_peekToken(tokens);
+static bool parseElement(struct TokenCursor* tokens, struct ARENA* arena, struct ELEMENT** element) {
+    int type = elementType(tokencursor_peek(tokens).id);
+    if (type < 0) return false;
+
+    *element = (struct ELEMENT*)newNode(arena, sizeof(struct ELEMENT));
+    (*element)->element_type = type;
+    (*element)->element_value = nodeValue(tokens);
+    (*element)->address = -1;
+    decodeLiteral(arena, *element);
+    tokencursor_advance(tokens);
+    return true;
+}
+
+static bool parseUnaryExpression(struct TokenCursor* tokens, struct ARENA* arena, struct UNARY_EXPR** unary) {
+    struct Token curToken = tokencursor_peek(tokens);
+    *unary = (struct UNARY_EXPR*)newNode(arena, sizeof(struct UNARY_EXPR));
     if (curToken.id == nuPy_ASTERISK || curToken.id == nuPy_AMPERSAND ||
         curToken.id == nuPy_PLUS || curToken.id == nuPy_MINUS) {
-        tokenqueue_dequeue(tokens);
-        if (curToken.id == nuPy_PLUS || curToken.id == nuPy_MINUS) {
-            curToken = tokenqueue_peekToken(tokens);
-            if (curToken.id == nuPy_IDENTIFIER || curToken.id == nuPy_INT_LITERAL || curToken.id == nuPy_REAL_LITERAL) {
-                tokenqueue_dequeue(tokens);
-                return true;
-            }
+        (*unary)->expr_type = (curToken.id == nuPy_ASTERISK) ? UNARY_PTR_DEREF :
+                              (curToken.id == nuPy_AMPERSAND) ? UNARY_ADDRESS_OF :
+                              (curToken.id == nuPy_PLUS) ? UNARY_PLUS : UNARY_MINUS;
+        tokencursor_advance(tokens);
+        curToken = tokencursor_peek(tokens);
+        if ((*unary)->expr_type == UNARY_PLUS || (*unary)->expr_type == UNARY_MINUS) {
+            if (curToken.id == nuPy_IDENTIFIER || curToken.id == nuPy_INT_LITERAL || curToken.id == nuPy_REAL_LITERAL)
+                return parseElement(tokens, arena, &(*unary)->element);
             return false;
         }
+        if (curToken.id == nuPy_IDENTIFIER) return parseElement(tokens, arena, &(*unary)->element);
         return verifyToken(tokens, nuPy_IDENTIFIER, "IDENTIFIER");
     }
-    return parseElement(tokens);
+    (*unary)->expr_type = UNARY_ELEMENT;
+    return parseElement(tokens, arena, &(*unary)->element);
 }
 
-static bool parseOperator(struct TokenQueue* tokens) {
-    struct Token curToken = tokenqueue_peekToken(tokens);
-    if (curToken.id == nuPy_ASTERISK || curToken.id == nuPy_PLUS || curToken.id == nuPy_MINUS ||
-        curToken.id == nuPy_POWER || curToken.id == nuPy_PERCENT || curToken.id == nuPy_SLASH ||
-        curToken.id == nuPy_EQUALEQUAL || curToken.id == nuPy_NOTEQUAL || curToken.id == nuPy_LT ||
-        curToken.id == nuPy_LTE || curToken.id == nuPy_GT || curToken.id == nuPy_GTE ||
-        curToken.id == nuPy_KEYW_IS || curToken.id == nuPy_KEYW_IN) {
-        tokenqueue_dequeue(tokens);
-        return true;
-    }
-    return false;
+static bool parseOperator(struct TokenCursor* tokens, int* operator) {
+    *operator = operatorType(tokencursor_peek(tokens).id);
+    if (*operator == OPERATOR_NO_OP) return false;
+    tokencursor_advance(tokens);
+    return true;
 }
 
-static bool parseFunctionCall(struct TokenQueue* tokens) {
-    if (!verifyToken(tokens, nuPy_IDENTIFIER, "IDENTIFIER")) return false;
+static bool parseFunctionCall(struct TokenCursor* tokens, struct ARENA* arena, char** name, struct ELEMENT** parameter) {
+    if (!verifyIdentifier(tokens, name)) return false;
     if (!verifyToken(tokens, nuPy_LEFT_PAREN, "(")) return false;
-    if (parseElement(tokens)) {}
+    if (parseElement(tokens, arena, parameter)) {}
     return verifyToken(tokens, nuPy_RIGHT_PAREN, ")");
 }
 
-static bool parseValue(struct TokenQueue* tokens) {
-    struct Token nextToken = tokenqueue_peek2Token(tokens);
-    if (nextToken.id == nuPy_LEFT_PAREN) return parseFunctionCall(tokens);
-    if (!parseExpression(tokens)) {
-        struct Token currentToken = tokenqueue_peekToken(tokens);
-        char* curValue = tokenqueue_peekValue(tokens);
+static bool parseValue(struct TokenCursor* tokens, struct ARENA* arena, struct VALUE** value) {
+    *value = (struct VALUE*)newNode(arena, sizeof(struct VALUE));
+    struct Token nextToken = tokencursor_peek2(tokens);
+    if (nextToken.id == nuPy_LEFT_PAREN) {
+        struct FUNCTION_CALL* call = (struct FUNCTION_CALL*)newNode(arena, sizeof(struct FUNCTION_CALL));
+        (*value)->value_type = VALUE_FUNCTION_CALL;
+        (*value)->types.function_call = call;
+        return parseFunctionCall(tokens, arena, &call->function_name, &call->parameter);
+    }
+    (*value)->value_type = VALUE_EXPR;
+    if (!parseExpression(tokens, arena, &(*value)->types.expr)) {
+        struct Token currentToken = tokencursor_peek(tokens);
+        char* curValue = tokencursor_value(tokens);
         if (currentToken.id != nuPy_IDENTIFIER && currentToken.id != nuPy_REAL_LITERAL &&
             currentToken.id != nuPy_INT_LITERAL && currentToken.id != nuPy_STR_LITERAL) {
             printSyntaxError("expected an identifier, numeric literal, or valid expression", curValue, currentToken);
@@ -100,86 +288,281 @@ static bool parseValue(struct TokenQueue* tokens) {
     return true;
 }
 
-static bool parseAssignment(struct TokenQueue* tokens) {
-    struct Token currentToken = tokenqueue_peekToken(tokens);
-    if (currentToken.id == nuPy_ASTERISK) tokenqueue_dequeue(tokens);
-    if (!verifyToken(tokens, nuPy_IDENTIFIER, "IDENTIFIER")) return false;
+static bool parseAssignment(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** stmt) {
+    struct Token currentToken = tokencursor_peek(tokens);
+    *stmt = newStmt(arena, STMT_ASSIGNMENT, currentToken.line);
+    struct STMT_ASSIGNMENT* assignment = (*stmt)->types.assignment;
+    if (currentToken.id == nuPy_ASTERISK) {
+        assignment->isPtrDeref = true;
+        tokencursor_advance(tokens);
+    }
+    if (!verifyIdentifier(tokens, &assignment->var_name)) return false;
     if (!verifyToken(tokens, nuPy_EQUAL, "=")) return false;
-    if (!parseValue(tokens)) return false;
+    if (!parseValue(tokens, arena, &assignment->rhs)) return false;
     return verifyToken(tokens, nuPy_EOLN, "EOLN");
 }
 
-static bool parseWhileLoop(struct TokenQueue* tokens) {
+static bool parseWhileLoop(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** stmt) {
+    *stmt = newStmt(arena, STMT_WHILE_LOOP, tokencursor_peek(tokens).line);
+    struct STMT_WHILE_LOOP* loop = (*stmt)->types.while_loop;
     if (!verifyToken(tokens, nuPy_KEYW_WHILE, "while")) return false;
-    if (!parseExpression(tokens)) return false;
+    if (!parseExpression(tokens, arena, &loop->condition)) return false;
     if (!verifyToken(tokens, nuPy_COLON, ":")) return false;
     if (!verifyToken(tokens, nuPy_EOLN, "EOLN")) return false;
-    return parseBlock(tokens);
+    if (!parseBlock(tokens, arena, &loop->loop_body)) return false;
+    linkStmt(lastStmt(loop->loop_body), *stmt);    // back to the condition
+    return true;
 }
 
-static bool parseExpression(struct TokenQueue* tokens) {
-    if (!parseUnaryExpression(tokens)) return false;
-    if (parseOperator(tokens)) {
-        if (!parseUnaryExpression(tokens)) return false;
+static bool parseExpression(struct TokenCursor* tokens, struct ARENA* arena, struct EXPR** expr) {
+    *expr = (struct EXPR*)newNode(arena, sizeof(struct EXPR));
+    (*expr)->operator = OPERATOR_NO_OP;
+    if (!parseUnaryExpression(tokens, arena, &(*expr)->lhs)) return false;
+    if (parseOperator(tokens, &(*expr)->operator)) {
+        (*expr)->isBinaryExpr = true;
+        if (!parseUnaryExpression(tokens, arena, &(*expr)->rhs)) return false;
     }
     return true;
 }
 
-static bool parseBlock(struct TokenQueue* tokens) {
+static bool parseBlock(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** body) {
+    if (tokens->lazy != NULL) return deferBlock(tokens, arena, body);
+    return buildBlock(tokens, arena, body);
+}
+
+static bool buildBlock(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** body) {
+    int line = tokencursor_peek(tokens).line;
+    struct STMT* tail;
     if (!verifyToken(tokens, nuPy_LEFT_BRACE, "{")) return false;
     if (!verifyToken(tokens, nuPy_EOLN, "EOLN")) return false;
-    if (!parseStatementList(tokens)) return false;
+    if (!parseStatementList(tokens, arena, body, &tail)) return false;
+    // a block of blank lines still needs a statement to run
+    if (*body == NULL) *body = newStmt(arena, STMT_PASS, line);
     return verifyToken(tokens, nuPy_RIGHT_BRACE, "}");
 }
 
-static bool parseElse(struct TokenQueue* tokens) {
-    struct Token currentToken = tokenqueue_peekToken(tokens);
+//
+// Everything a lazily built graph needs to build the rest of
+// itself: the program's tokens, and the arena and intern table
+// the rest of the graph is in. Deferred blocks are checked in
+// the scratch arena, and checked marks the end of the tokens
+// checked so far, so blocks nested in a checked block are not
+// checked again when it is built.
+//
+struct LAZY_SOURCE {
+    struct TokenQueue* tokens;
+    struct ARENA* arena;
+    struct INTERN_TABLE* interns;
+    struct ARENA* scratch;
+    int checked;
+};
+
+//
+// checkBlock
+//
+// Syntax check only: parses the block at the cursor, nested
+// blocks and all, in the scratch arena, without interning its
+// values, and throws the nodes away again.
+//
+static bool checkBlock(struct TokenCursor* tokens) {
+    struct LAZY_SOURCE* lazy = tokens->lazy;
+    struct INTERN_TABLE* interns = tokens->interns;
+    tokens->lazy = NULL;
+    tokens->interns = NULL;
+
+    struct STMT* body;
+    bool valid = buildBlock(tokens, lazy->scratch, &body);
+
+    tokens->lazy = lazy;
+    tokens->interns = interns;
+    arena_reset(lazy->scratch);
+    return valid;
+}
+
+//
+// deferBlock
+//
+// Skips over a block to its matching '}', leaving a
+// STMT_LAZY_BLOCK in place of the statements in it. Only
+// building the graph is deferred: a block not yet checked is
+// checked as it is skipped, so a syntax error in it fails the
+// parse as it would have eagerly. Blocks only nest in blocks,
+// so counting braces is enough to find the end of one that
+// was checked before.
+//
+static bool deferBlock(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** body) {
+    struct Token brace = tokencursor_peek(tokens);
+    int start = tokens->position;
+    struct LAZY_SOURCE* lazy = tokens->lazy;
+
+    if (start >= lazy->checked) {
+        if (!checkBlock(tokens)) return false;
+        lazy->checked = tokens->position;
+    }
+    else {
+        tokencursor_advance(tokens);    // the '{' and EOLN
+        tokencursor_advance(tokens);
+        int depth = 0;
+        for (struct Token token = tokencursor_peek(tokens); token.id != nuPy_RIGHT_BRACE || depth > 0; token = tokencursor_peek(tokens)) {
+            if (token.id == nuPy_LEFT_BRACE) depth++;
+            else if (token.id == nuPy_RIGHT_BRACE) depth--;
+            tokencursor_advance(tokens);
+        }
+        tokencursor_advance(tokens);
+    }
+
+    *body = newStmt(arena, STMT_LAZY_BLOCK, brace.line);
+    (*body)->types.lazy_block->source = lazy;
+    (*body)->types.lazy_block->start = start;
+    (*body)->types.lazy_block->referrer = body;
+    return true;
+}
+
+static bool parseElse(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** stmt) {
+    struct Token currentToken = tokencursor_peek(tokens);
     if (currentToken.id == nuPy_KEYW_ELIF) {
-        tokenqueue_dequeue(tokens);
-        if (!parseExpression(tokens)) return false;
+        // an elif is an if/else nested in the false path
+        *stmt = newStmt(arena, STMT_IF_THEN_ELSE, currentToken.line);
+        struct STMT_IF_THEN_ELSE* ifThenElse = (*stmt)->types.if_then_else;
+        tokencursor_advance(tokens);
+        if (!parseExpression(tokens, arena, &ifThenElse->condition)) return false;
         if (!verifyToken(tokens, nuPy_COLON, ":")) return false;
         if (!verifyToken(tokens, nuPy_EOLN, "EOLN")) return false;
-        if (!parseBlock(tokens)) return false;
-        struct Token nextToken = tokenqueue_peekToken(tokens);
-        if (nextToken.id == nuPy_KEYW_ELIF || nextToken.id == nuPy_KEYW_ELSE) return parseElse(tokens);
+        if (!parseBlock(tokens, arena, &ifThenElse->true_path)) return false;
+        struct Token nextToken = tokencursor_peek(tokens);
+        if (nextToken.id == nuPy_KEYW_ELIF || nextToken.id == nuPy_KEYW_ELSE) return parseElse(tokens, arena, &ifThenElse->false_path);
         return true;
     } else if (currentToken.id == nuPy_KEYW_ELSE) {
-        tokenqueue_dequeue(tokens);
+        tokencursor_advance(tokens);
         if (!verifyToken(tokens, nuPy_COLON, ":")) return false;
         if (!verifyToken(tokens, nuPy_EOLN, "EOLN")) return false;
-        return parseBlock(tokens);
+        return parseBlock(tokens, arena, stmt);
     }
     return false;
 }
 
-static bool parseIfElse(struct TokenQueue* tokens) {
+static bool parseIfElse(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** stmt) {
+    *stmt = newStmt(arena, STMT_IF_THEN_ELSE, tokencursor_peek(tokens).line);
+    struct STMT_IF_THEN_ELSE* ifThenElse = (*stmt)->types.if_then_else;
     if (!verifyToken(tokens, nuPy_KEYW_IF, "if")) return false;
-    if (!parseExpression(tokens)) return false;
+    if (!parseExpression(tokens, arena, &ifThenElse->condition)) return false;
     if (!verifyToken(tokens, nuPy_COLON, ":")) return false;
     if (!verifyToken(tokens, nuPy_EOLN, "EOLN")) return false;
-    if (!parseBlock(tokens)) return false;
-    struct Token currentToken = tokenqueue_peekToken(tokens);
-    if (currentToken.id == nuPy_KEYW_ELIF || currentToken.id == nuPy_KEYW_ELSE) return parseElse(tokens);
+    if (!parseBlock(tokens, arena, &ifThenElse->true_path)) return false;
+    struct Token currentToken = tokencursor_peek(tokens);
+    if (currentToken.id == nuPy_KEYW_ELIF || currentToken.id == nuPy_KEYW_ELSE) return parseElse(tokens, arena, &ifThenElse->false_path);
     return true;
 }
 
-static bool parseStatementList(struct TokenQueue* tokens) {
-    if (!parseStatement(tokens)) return false;
-    if (isStatementStart(tokens)) return parseStatementList(tokens);
+static bool parsePass(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** stmt) {
+    *stmt = newStmt(arena, STMT_PASS, tokencursor_peek(tokens).line);
+    if (!verifyToken(tokens, nuPy_KEYW_PASS, "pass")) return false;
+    return verifyToken(tokens, nuPy_EOLN, "EOLN");
+}
+
+static bool parseEmpty(struct TokenCursor* tokens, struct STMT** stmt) {
+    *stmt = NULL;    // blank lines are not part of the graph
+    return verifyToken(tokens, nuPy_EOLN, "EOLN");
+}
+
+static bool isStatementStart(struct TokenCursor* tokens) {
+    struct Token curToken = tokencursor_peek(tokens);
+    return curToken.id == nuPy_EOLN || curToken.id == nuPy_KEYW_PASS ||
+           curToken.id == nuPy_KEYW_IF || curToken.id == nuPy_KEYW_WHILE ||
+           curToken.id == nuPy_IDENTIFIER || curToken.id == nuPy_ASTERISK;
+}
+
+static bool parseStatement(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** stmt) {
+    struct Token curToken = tokencursor_peek(tokens);
+    if (curToken.id == nuPy_EOLN) return parseEmpty(tokens, stmt);
+    if (curToken.id == nuPy_KEYW_PASS) return parsePass(tokens, arena, stmt);
+    if (curToken.id == nuPy_KEYW_IF) return parseIfElse(tokens, arena, stmt);
+    if (curToken.id == nuPy_KEYW_WHILE) return parseWhileLoop(tokens, arena, stmt);
+    if (curToken.id == nuPy_IDENTIFIER && tokencursor_peek2(tokens).id == nuPy_LEFT_PAREN) {
+        *stmt = newStmt(arena, STMT_FUNCTION_CALL, curToken.line);
+        struct STMT_FUNCTION_CALL* call = (*stmt)->types.function_call;
+        if (!parseFunctionCall(tokens, arena, &call->function_name, &call->parameter)) return false;
+        return verifyToken(tokens, nuPy_EOLN, "EOLN");
+    }
+    if (curToken.id == nuPy_IDENTIFIER || curToken.id == nuPy_ASTERISK) return parseAssignment(tokens, arena, stmt);
+    printSyntaxError("start of statement", tokencursor_value(tokens), curToken);
+    return false;
+}
+
+//
+// parseStatementList
+//
+// Parses statements for as long as they keep coming, linking
+// each to the one before it. The last statement is left for
+// the caller to link; head is NULL if there were only blank
+// lines.
+//
+static bool parseStatementList(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** head, struct STMT** tail) {
+    *head = NULL;
+    *tail = NULL;
+    do {
+        struct STMT* stmt;
+        if (!parseStatement(tokens, arena, &stmt)) return false;
+        if (stmt == NULL) continue;
+        if (*head == NULL) *head = stmt;
+        else linkStmt(*tail, stmt);
+        *tail = stmt;
+    } while (isStatementStart(tokens));
     return true;
 }
 
-static bool parseProgram(struct TokenQueue* tokens) {
-    if (!parseStatementList(tokens)) return false;
+static bool parseProgram(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** program) {
+    int line = tokencursor_peek(tokens).line;
+    struct STMT* tail;
+    if (!parseStatementList(tokens, arena, program, &tail)) return false;
+    if (*program == NULL) *program = newStmt(arena, STMT_PASS, line);
     return verifyToken(tokens, nuPy_EOS, "$");
 }
 
-struct TokenQueue* parser_parse(FILE* input) {
-    if (!input) {
-        printf("**INTERNAL ERROR: null input stream\n");
-        return NULL;
-    }
+//
+// buildProgram
+//
+// Parses the program, building its graph in the arena with
+// the cursor interning values into it.
+//
+static bool buildProgram(struct TokenCursor* tokens, struct ARENA* arena, struct STMT** program) {
+    struct INTERN_TABLE* interns = intern_init(arena);
+    tokens->interns = interns;
+    bool valid = parseProgram(tokens, arena, program);
+    tokens->interns = NULL;
+    intern_destroy(interns);
+    return valid;
+}
+
+//
+// checkProgram
+//
+// Syntax check only: the graph is built as usual and thrown
+// away with its arena.
+//
+static bool checkProgram(struct TokenCursor* tokens) {
+    struct ARENA* arena = arena_init();
+    struct STMT* program;
+    bool valid = buildProgram(tokens, arena, &program);
+    arena_destroy(arena);
+    return valid;
+}
 
+static struct TokenQueue* parseTokens(struct TokenQueue* tokens) {
+    // the parser walks a cursor, so the queue comes back untouched
+    struct TokenCursor cursor = tokenqueue_cursor(tokens);
+    if (checkProgram(&cursor)) return tokens;
+
+    tokenqueue_destroy(tokens);
+    return NULL;
+}
+
+//
+// scanInput
+//
+// Scans the input through the EOS into a new queue.
+//
+static struct TokenQueue* scanInput(FILE* input) {
     int line, column;
     char tokenValue[256];
     struct Token token;
@@ -194,15 +577,244 @@ struct TokenQueue* parser_parse(FILE* input) {
     }
 
     tokenqueue_enqueue(tokens, token, tokenValue);
-    struct TokenQueue* duplicate = tokenqueue_duplicate(tokens);
-    bool success = parseProgram(tokens);
+    return tokens;
+}
 
+struct TokenQueue* parser_parse(FILE* input) {
+    if (!input) {
+        printf("**INTERNAL ERROR: null input stream\n");
+        return NULL;
+    }
+
+    return parseTokens(scanInput(input));
+}
+
+struct STMT* parser_parseProgram(FILE* input, struct ARENA* arena) {
+    if (!input) {
+        printf("**INTERNAL ERROR: null input stream\n");
+        return NULL;
+    }
+
+    // keyboard input is read through the $ before parsing starts
+    struct TokenQueue* tokens = scanInput(input);
+    struct TokenCursor cursor = tokenqueue_cursor(tokens);
+    struct STMT* program;
+    bool valid = buildProgram(&cursor, arena, &program);
     tokenqueue_destroy(tokens);
+    return valid ? program : NULL;
+}
 
-    if (success) {
-        return duplicate;
-    } else {
-        tokenqueue_destroy(duplicate);
+//
+// fetchSpan
+//
+// TokenFetch for a streaming cursor over a ScannerSource.
+//
+static struct Token fetchSpan(void* state, const char** value, int* length) {
+    struct TokenSpan span;
+    struct Token token = scanner_nextTokenSpan((struct ScannerSource*)state, &span);
+    *value = span.start;
+    *length = span.length;
+    return token;
+}
+
+bool parser_parseStream(struct ScannerSource* source, struct TokenQueue* tokens) {
+    if (!source) {
+        printf("**INTERNAL ERROR: null input source\n");
+        return false;
+    }
+
+    struct TokenCursor cursor = tokencursor_stream(fetchSpan, source, tokens);
+    bool valid = checkProgram(&cursor);
+    tokencursor_close(&cursor);
+    return valid;
+}
+
+//
+// scanSource
+//
+// Scans the rest of the source into a new queue, in
+// parallel if it is large and there are cores to spare.
+//
+static struct TokenQueue* scanSource(struct ScannerSource* source) {
+    struct TokenQueue* tokens = tokenqueue_create();
+
+    if (source->end - source->pos >= PARALLEL_SCAN_MIN_BYTES && sysconf(_SC_NPROCESSORS_ONLN) > 1) {
+        int count;
+        struct SpanToken* scanned = scanner_scanParallel(source, 0, &count);
+        for (int i = 0; i < count; i++)
+            tokenqueue_enqueueSpan(tokens, scanned[i].token, scanned[i].span.start, scanned[i].span.length);
+        free(scanned);
+        return tokens;
+    }
+
+    struct TokenSpan span;
+    struct Token token;
+    do {
+        token = scanner_nextTokenSpan(source, &span);
+        tokenqueue_enqueueSpan(tokens, token, span.start, span.length);
+    } while (token.id != nuPy_EOS);
+    return tokens;
+}
+
+struct TokenQueue* parser_parseSource(struct ScannerSource* source) {
+    if (!source) {
+        printf("**INTERNAL ERROR: null input source\n");
         return NULL;
     }
+
+    // a large source on several cores is scanned up front, in parallel;
+    // otherwise scanning and parsing go hand in hand, so a syntax error
+    // is reported as soon as it is reached
+    if (source->end - source->pos >= PARALLEL_SCAN_MIN_BYTES && sysconf(_SC_NPROCESSORS_ONLN) > 1)
+        return parseTokens(scanSource(source));
+
+    struct TokenQueue* tokens = tokenqueue_create();
+    if (parser_parseStream(source, tokens)) return tokens;
+
+    tokenqueue_destroy(tokens);
+    return NULL;
+}
+
+// the tokens of a parallel scan, handed out one at a time
+struct ScannedTokens {
+    struct SpanToken* tokens;
+    int count;
+    int next;
+};
+
+//
+// fetchScanned
+//
+// TokenFetch for a streaming cursor over the result of
+// scanner_scanParallel, which always ends in EOS.
+//
+static struct Token fetchScanned(void* state, const char** value, int* length) {
+    struct ScannedTokens* scanned = (struct ScannedTokens*)state;
+    struct SpanToken* token = &scanned->tokens[scanned->next];
+    if (scanned->next < scanned->count - 1) scanned->next++;
+    *value = token->span.start;
+    *length = token->span.length;
+    return token->token;
+}
+
+struct STMT* parser_parseProgramSource(struct ScannerSource* source, struct ARENA* arena) {
+    if (!source) {
+        printf("**INTERNAL ERROR: null input source\n");
+        return NULL;
+    }
+
+    struct STMT* program;
+    bool valid;
+
+    // as in parser_parseSource, but no token queue is kept either way
+    if (source->end - source->pos >= PARALLEL_SCAN_MIN_BYTES && sysconf(_SC_NPROCESSORS_ONLN) > 1) {
+        struct ScannedTokens scanned;
+        scanned.tokens = scanner_scanParallel(source, 0, &scanned.count);
+        scanned.next = 0;
+        struct TokenCursor cursor = tokencursor_stream(fetchScanned, &scanned, NULL);
+        valid = buildProgram(&cursor, arena, &program);
+        tokencursor_close(&cursor);
+        free(scanned.tokens);
+    }
+    else {
+        struct TokenCursor cursor = tokencursor_stream(fetchSpan, source, NULL);
+        valid = buildProgram(&cursor, arena, &program);
+        tokencursor_close(&cursor);
+    }
+
+    return valid ? program : NULL;
+}
+
+struct STMT* parser_parseProgramLazy(struct ScannerSource* source, struct ARENA* arena, struct LAZY_SOURCE** lazy) {
+    *lazy = NULL;
+    if (!source) {
+        printf("**INTERNAL ERROR: null input source\n");
+        return NULL;
+    }
+
+    struct LAZY_SOURCE* deferred = (struct LAZY_SOURCE*)malloc(sizeof(struct LAZY_SOURCE));
+    deferred->tokens = scanSource(source);
+    deferred->arena = arena;
+    deferred->interns = intern_init(arena);
+    deferred->scratch = arena_init();
+    deferred->checked = 0;
+
+    struct TokenCursor cursor = tokenqueue_cursor(deferred->tokens);
+    cursor.interns = deferred->interns;
+    cursor.lazy = deferred;
+    struct STMT* program;
+    if (!parseProgram(&cursor, arena, &program)) {
+        parser_releaseLazy(deferred);
+        return NULL;
+    }
+
+    *lazy = deferred;
+    return program;
+}
+
+//
+// parser_buildBlock
+//
+// Parses the deferred block from its '{', deferring the blocks
+// nested in it in turn, and splices the statements into the
+// graph where the placeholder was. The block was checked when
+// the program was parsed, so this cannot fail.
+//
+struct STMT* parser_buildBlock(struct STMT* stmt) {
+    assert(stmt->stmt_type == STMT_LAZY_BLOCK);
+    struct STMT_LAZY_BLOCK* block = stmt->types.lazy_block;
+    struct LAZY_SOURCE* source = block->source;
+
+    struct TokenCursor cursor = tokenqueue_cursor(source->tokens);
+    cursor.position = block->start;
+    cursor.interns = source->interns;
+    cursor.lazy = source;
+
+    struct STMT* body;
+    bool valid = buildBlock(&cursor, source->arena, &body);
+    assert(valid);
+
+    linkStmt(lastStmt(body), block->next_stmt);
+    *block->referrer = body;
+    return body;
+}
+
+struct ARENA* parser_blockArena(struct STMT* stmt) {
+    assert(stmt->stmt_type == STMT_LAZY_BLOCK);
+    return stmt->types.lazy_block->source->arena;
+}
+
+//
+// parser_blockNames
+//
+// Walks the deferred block's tokens from its '{' to the matching
+// '}', nested blocks and all, passing each identifier that is not
+// a function name to visit. The grammar names every variable by
+// a lone identifier, so these are the names the block's graph
+// will bind, in the order it binds them.
+//
+void parser_blockNames(struct STMT* stmt, NameVisit visit, void* state) {
+    assert(stmt->stmt_type == STMT_LAZY_BLOCK);
+    struct STMT_LAZY_BLOCK* block = stmt->types.lazy_block;
+
+    struct TokenCursor cursor = tokenqueue_cursor(block->source->tokens);
+    cursor.position = block->start;
+    tokencursor_advance(&cursor);    // the '{'
+
+    int depth = 0;
+    for (struct Token token = tokencursor_peek(&cursor); token.id != nuPy_RIGHT_BRACE || depth > 0; token = tokencursor_peek(&cursor)) {
+        if (token.id == nuPy_LEFT_BRACE) depth++;
+        else if (token.id == nuPy_RIGHT_BRACE) depth--;
+        else if (token.id == nuPy_IDENTIFIER && tokencursor_peek2(&cursor).id != nuPy_LEFT_PAREN)
+            visit(state, tokencursor_value(&cursor));
+        tokencursor_advance(&cursor);
+    }
+}
+
+void parser_releaseLazy(struct LAZY_SOURCE* lazy) {
+    if (lazy == NULL) return;
+    tokenqueue_destroy(lazy->tokens);
+    intern_destroy(lazy->interns);
+    arena_destroy(lazy->scratch);
+    free(lazy);
 }
@@ -4,10 +4,63 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include "token.h"
+#include "scanner.h"
 #include "tokenqueue.h"
+#include "programgraph.h"
+#include "arena.h"
 
 // Initializes the parsing process and returns a queue of tokens representing the parsed program.
 // If parsing fails, returns NULL.
 struct TokenQueue* parser_parse(FILE* input);
 
+// Same as parser_parse, but scans the given in-memory source (see scanner.h),
+// which is typically a memory-mapped file.
+struct TokenQueue* parser_parseSource(struct ScannerSource* source);
+
+// Parses the source as it is scanned: the parser pulls each token from the
+// scanner when it needs it, holding at most two at a time, and stops at the
+// first syntax error. If tokens is not NULL, every token scanned is appended
+// to it; if it is NULL, memory use does not grow with the input. Returns true
+// if the syntax is valid.
+bool parser_parseStream(struct ScannerSource* source, struct TokenQueue* tokens);
+
+// Parses the program and builds its program graph in one pass, with every
+// node allocated from the given arena; free the graph by destroying the arena
+// (not with programgraph_destroy). Returns NULL if parsing fails. A program of
+// only blank lines is a single pass statement, and so is an empty block.
+// Names and literal values are interned (see intern.h): equal text in the
+// graph is always the same pointer.
+struct STMT* parser_parseProgram(FILE* input, struct ARENA* arena);
+
+// Same as parser_parseProgram, but scans the given in-memory source; no token
+// queue is built along the way.
+struct STMT* parser_parseProgramSource(struct ScannerSource* source, struct ARENA* arena);
+
+// Same as parser_parseProgramSource, except that the statements of every block
+// (loop bodies and if/else paths) are left unparsed, with a STMT_LAZY_BLOCK in
+// their place, until parser_buildBlock is called on it the first time execution
+// gets there. Every block is still checked up front, so a syntax error in one
+// fails the parse as it does eagerly; only building its nodes is put off. The
+// tokens are kept in *lazy until parser_releaseLazy; the arena must outlive it.
+struct STMT* parser_parseProgramLazy(struct ScannerSource* source, struct ARENA* arena, struct LAZY_SOURCE** lazy);
+
+// Builds the statements of a deferred block, leaving the blocks nested in it
+// deferred, and links them into the graph in the block's place. Returns the
+// block's first statement.
+struct STMT* parser_buildBlock(struct STMT* block);
+
+// Returns the arena a deferred block's statements are built in
+struct ARENA* parser_blockArena(struct STMT* block);
+
+// Receives each name parser_blockNames finds, in the caller's state
+typedef void (*NameVisit)(void* state, char* name);
+
+// Calls visit with every variable name in a deferred block (nested blocks
+// included) in source order, without building it, so the names can be bound
+// in the order an eagerly built graph would bind them
+void parser_blockNames(struct STMT* block, NameVisit visit, void* state);
+
+// Frees the tokens kept for deferred blocks; no block can be built after this
+void parser_releaseLazy(struct LAZY_SOURCE* lazy);
+
 #endif // PARSER_H
@@ -0,0 +1,402 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "scanner.h"
+
+//
+// Character-class scanning works on SCAN_STRIDE bytes at a time:
+// 32 with AVX2, 16 with SSE2 (always available on x86-64), and a
+// compare yields a bitmask with one bit per byte. The stride is
+// picked at compile time, so build with -mavx2 (or -march=native)
+// to get the wider one. Elsewhere, or with SCANNER_NO_SIMD defined,
+// only the scalar loops are used; they also finish every scan once
+// fewer than SCAN_STRIDE bytes are left, so no load ever reads past
+// the end of the source.
+//
+#if !defined(SCANNER_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_STRIDE 32
+#define SCAN_ALL_BITS 0xFFFFFFFFu
+typedef __m256i ScanVector;
+#define scanLoad(p) _mm256_loadu_si256((const __m256i*)(p))
+#define scanSplat(c) _mm256_set1_epi8((char)(c))
+#define scanEq(a, b) _mm256_cmpeq_epi8(a, b)
+#define scanGt(a, b) _mm256_cmpgt_epi8(a, b)
+#define scanOr(a, b) _mm256_or_si256(a, b)
+#define scanAnd(a, b) _mm256_and_si256(a, b)
+#define scanBits(v) ((uint32_t)_mm256_movemask_epi8(v))
+#elif !defined(SCANNER_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define SCAN_STRIDE 16
+#define SCAN_ALL_BITS 0xFFFFu
+typedef __m128i ScanVector;
+#define scanLoad(p) _mm_loadu_si128((const __m128i*)(p))
+#define scanSplat(c) _mm_set1_epi8((char)(c))
+#define scanEq(a, b) _mm_cmpeq_epi8(a, b)
+#define scanGt(a, b) _mm_cmpgt_epi8(a, b)
+#define scanOr(a, b) _mm_or_si128(a, b)
+#define scanAnd(a, b) _mm_and_si128(a, b)
+#define scanBits(v) ((uint32_t)_mm_movemask_epi8(v))
+#endif
+
+#ifdef SCAN_STRIDE
+//
+// scanInRange
+//
+// Marks the bytes of v in [lo, hi]. The compares are signed,
+// which is safe for ASCII ranges: bytes >= 0x80 are negative
+// and never match.
+//
+static inline ScanVector scanInRange(ScanVector v, char lo, char hi) {
+    return scanAnd(scanGt(v, scanSplat(lo - 1)), scanGt(scanSplat(hi + 1), v));
+}
+
+//
+// scanFirst
+//
+// Returns the index of the first marked byte, given the mask
+// of a compare; the mask must not be 0.
+//
+static inline int scanFirst(uint32_t bits) {
+    return __builtin_ctz(bits);
+}
+#endif
+
+//
+// skipBlanks
+//
+// Returns the first character at or after p that is not a
+// space, tab or carriage return.
+//
+static inline const char* skipBlanks(const char* p, const char* end) {
+#ifdef SCAN_STRIDE
+    for (; end - p >= SCAN_STRIDE; p += SCAN_STRIDE) {
+        ScanVector v = scanLoad(p);
+        ScanVector blank = scanOr(scanOr(scanEq(v, scanSplat(' ')), scanEq(v, scanSplat('\t'))), scanEq(v, scanSplat('\r')));
+        uint32_t other = ~scanBits(blank) & SCAN_ALL_BITS;
+        if (other != 0) return p + scanFirst(other);
+    }
+#endif
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+//
+// skipComment
+//
+// Returns the newline ending the comment at p, or end. memchr
+// is already vectorized by the C library.
+//
+static inline const char* skipComment(const char* p, const char* end) {
+    const char* newline = (const char*)memchr(p, '\n', (size_t)(end - p));
+    return newline != NULL ? newline : end;
+}
+
+//
+// identifierEnd
+//
+// Returns the first character at or after p that cannot be
+// part of an identifier (a letter, digit or underscore).
+//
+static inline const char* identifierEnd(const char* p, const char* end) {
+#ifdef SCAN_STRIDE
+    for (; end - p >= SCAN_STRIDE; p += SCAN_STRIDE) {
+        ScanVector v = scanLoad(p);
+        ScanVector letter = scanInRange(scanOr(v, scanSplat(0x20)), 'a', 'z');
+        ScanVector word = scanOr(scanOr(letter, scanInRange(v, '0', '9')), scanEq(v, scanSplat('_')));
+        uint32_t other = ~scanBits(word) & SCAN_ALL_BITS;
+        if (other != 0) return p + scanFirst(other);
+    }
+#endif
+    while (p < end && (isalnum((unsigned char)*p) || *p == '_')) p++;
+    return p;
+}
+
+//
+// digitsEnd
+//
+// Returns the first character at or after p that is not a
+// decimal digit.
+//
+static inline const char* digitsEnd(const char* p, const char* end) {
+#ifdef SCAN_STRIDE
+    for (; end - p >= SCAN_STRIDE; p += SCAN_STRIDE) {
+        uint32_t other = ~scanBits(scanInRange(scanLoad(p), '0', '9')) & SCAN_ALL_BITS;
+        if (other != 0) return p + scanFirst(other);
+    }
+#endif
+    while (p < end && isdigit((unsigned char)*p)) p++;
+    return p;
+}
+
+//
+// stringEnd
+//
+// Returns the closing quote of a string literal starting at
+// p, the newline that cuts it short, or end.
+//
+static inline const char* stringEnd(const char* p, const char* end, char quote) {
+#ifdef SCAN_STRIDE
+    for (; end - p >= SCAN_STRIDE; p += SCAN_STRIDE) {
+        ScanVector v = scanLoad(p);
+        uint32_t stop = scanBits(scanOr(scanEq(v, scanSplat(quote)), scanEq(v, scanSplat('\n'))));
+        if (stop != 0) return p + scanFirst(stop);
+    }
+#endif
+    while (p < end && *p != quote && *p != '\n') p++;
+    return p;
+}
+
+// EOLN and EOS have no text of their own in the source
+static const char EOLN_VALUE[] = "EOLN";
+static const char EOS_VALUE[] = "$";
+
+#ifdef SCANNER_LINEAR_KEYWORDS
+
+// the original table search, kept for comparison (see bench/keyword_bench.c)
+static const char* const keywords[] = {
+    "True", "False", "None", "is", "in", "if", "while", "elif", "else", "pass"
+};
+
+static const int keywordIDs[] = {
+    nuPy_KEYW_TRUE, nuPy_KEYW_FALSE, nuPy_KEYW_NONE, nuPy_KEYW_IS, nuPy_KEYW_IN,
+    nuPy_KEYW_IF, nuPy_KEYW_WHILE, nuPy_KEYW_ELIF, nuPy_KEYW_ELSE, nuPy_KEYW_PASS
+};
+
+static int lookupKeyword(const char* start, int length) {
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
+        if ((int)strlen(keywords[i]) == length && memcmp(keywords[i], start, length) == 0)
+            return keywordIDs[i];
+    }
+    return nuPy_IDENTIFIER;
+}
+
+#else
+
+//
+// lookupKeyword
+//
+// Returns the keyword token ID for the given identifier span,
+// or nuPy_IDENTIFIER if it is not a keyword. The length and
+// first character leave at most one candidate, which is then
+// compared whole; fixed-size memcmps compile to a single load
+// and compare. Most identifiers are rejected by the length
+// alone. Keep in step with the keywords in token.h.
+//
+static int lookupKeyword(const char* start, int length) {
+    switch (length) {
+        case 2:
+            if (start[0] != 'i') break;
+            if (start[1] == 's') return nuPy_KEYW_IS;
+            if (start[1] == 'n') return nuPy_KEYW_IN;
+            if (start[1] == 'f') return nuPy_KEYW_IF;
+            break;
+        case 4:
+            switch (start[0]) {
+                case 'T': if (memcmp(start, "True", 4) == 0) return nuPy_KEYW_TRUE; break;
+                case 'N': if (memcmp(start, "None", 4) == 0) return nuPy_KEYW_NONE; break;
+                case 'p': if (memcmp(start, "pass", 4) == 0) return nuPy_KEYW_PASS; break;
+                case 'e':
+                    if (memcmp(start, "elif", 4) == 0) return nuPy_KEYW_ELIF;
+                    if (memcmp(start, "else", 4) == 0) return nuPy_KEYW_ELSE;
+                    break;
+            }
+            break;
+        case 5:
+            if (start[0] == 'F' && memcmp(start, "False", 5) == 0) return nuPy_KEYW_FALSE;
+            if (start[0] == 'w' && memcmp(start, "while", 5) == 0) return nuPy_KEYW_WHILE;
+            break;
+    }
+    return nuPy_IDENTIFIER;
+}
+
+#endif
+
+//
+// scanner_openFile
+//
+// Maps the given file read-only so it can be scanned in
+// place. An empty file is scanned as an empty buffer, since
+// it cannot be mapped.
+//
+bool scanner_openFile(struct ScannerSource* source, const char* filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    if (st.st_size == 0) {
+        close(fd);
+        scanner_openBuffer(source, "", 0);
+        return true;
+    }
+
+    void* mapping = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+    madvise(mapping, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    scanner_openBuffer(source, (const char*)mapping, (size_t)st.st_size);
+    source->mapping = mapping;
+    source->mapping_size = (size_t)st.st_size;
+    return true;
+}
+
+//
+// scanner_openBuffer
+//
+// Scans the given buffer in place; the caller keeps it alive
+// until the source is closed.
+//
+void scanner_openBuffer(struct ScannerSource* source, const char* buffer, size_t length) {
+    source->begin = buffer;
+    source->end = buffer + length;
+    source->pos = buffer;
+    source->line = 1;
+    source->column = 0;
+    source->mapping = NULL;
+    source->mapping_size = 0;
+}
+
+//
+// scanner_close
+//
+// Unmaps the source if it is a mapped file.
+//
+void scanner_close(struct ScannerSource* source) {
+    if (source->mapping != NULL) munmap(source->mapping, source->mapping_size);
+    source->mapping = NULL;
+    source->begin = source->end = source->pos = NULL;
+}
+
+//
+// scanner_nextTokenSpan
+//
+// Returns the next token of the source and sets span to its
+// text: the lexeme itself, or for a string literal the text
+// between the quotes. EOLN and EOS spans refer to fixed
+// strings rather than the source. Tokens are the same as
+// those of scanner_nextToken; lines and columns are 1-based.
+// Once the end of the source or $ is reached, every call
+// returns EOS.
+//
+struct Token scanner_nextTokenSpan(struct ScannerSource* source, struct TokenSpan* span) {
+    const char* p = source->pos;
+    const char* end = source->end;
+
+    // skip whitespace and comments, but not the newline ending a comment
+    const char* skipped = p;
+    for (;;) {
+        p = skipBlanks(p, end);
+        if (p < end && *p == '#') p = skipComment(p, end);
+        else break;
+    }
+    source->column += (int)(p - skipped);
+
+    struct Token token;
+    token.line = source->line;
+    token.col = source->column + 1;
+
+    if (p == end || *p == '$') {
+        source->pos = p;
+        token.id = nuPy_EOS;
+        span->start = EOS_VALUE;
+        span->length = 1;
+        return token;
+    }
+
+    const char* start = p;
+    char c = *p++;
+
+    if (c == '\n') {
+        source->pos = p;
+        source->line++;
+        source->column = 0;
+        token.id = nuPy_EOLN;
+        span->start = EOLN_VALUE;
+        span->length = 4;
+        return token;
+    }
+
+    if (isalpha((unsigned char)c) || c == '_') {
+        p = identifierEnd(p, end);
+        token.id = lookupKeyword(start, (int)(p - start));
+    }
+    else if (isdigit((unsigned char)c)) {
+        // digits, then at most one '.' and the digits after it
+        p = digitsEnd(p, end);
+        token.id = nuPy_INT_LITERAL;
+        if (p < end && *p == '.') {
+            p = digitsEnd(p + 1, end);
+            token.id = nuPy_REAL_LITERAL;
+        }
+    }
+    else if (c == '"' || c == '\'') {
+        // the literal runs to the closing quote, or up to the end of the line
+        const char* close = stringEnd(p, end, c);
+        span->start = p;
+        span->length = (int)(close - p);
+        p = (close < end && *close == c) ? close + 1 : close;
+        source->column += (int)(p - start);
+        source->pos = p;
+        token.id = nuPy_STR_LITERAL;
+        return token;
+    }
+    else {
+        // one switch on the first character; the two-character
+        // operators then only need to look at the next one
+        char next = (p < end) ? *p : '\0';
+        switch (c) {
+            case '*':
+                if (next == '*') { p++; token.id = nuPy_POWER; }
+                else token.id = nuPy_ASTERISK;
+                break;
+            case '=':
+                if (next == '=') { p++; token.id = nuPy_EQUALEQUAL; }
+                else token.id = nuPy_EQUAL;
+                break;
+            case '<':
+                if (next == '=') { p++; token.id = nuPy_LTE; }
+                else token.id = nuPy_LT;
+                break;
+            case '>':
+                if (next == '=') { p++; token.id = nuPy_GTE; }
+                else token.id = nuPy_GT;
+                break;
+            case '!':
+                if (next == '=') { p++; token.id = nuPy_NOTEQUAL; }
+                else token.id = nuPy_UNKNOWN;
+                break;
+            case '&': token.id = nuPy_AMPERSAND; break;
+            case '+': token.id = nuPy_PLUS; break;
+            case '-': token.id = nuPy_MINUS; break;
+            case '%': token.id = nuPy_PERCENT; break;
+            case '/': token.id = nuPy_SLASH; break;
+            case '(': token.id = nuPy_LEFT_PAREN; break;
+            case ')': token.id = nuPy_RIGHT_PAREN; break;
+            case '{': token.id = nuPy_LEFT_BRACE; break;
+            case '}': token.id = nuPy_RIGHT_BRACE; break;
+            case ':': token.id = nuPy_COLON; break;
+            default:  token.id = nuPy_UNKNOWN; break;
+        }
+    }
+
+    span->start = start;
+    span->length = (int)(p - start);
+    source->column += span->length;
+    source->pos = p;
+    return token;
+}
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "scanner.h"
+
+//
+// The stream scanner reads its input a line at a time and
+// scans each line in place with scanner_nextTokenSpan, so the
+// two scanners agree on every token by construction. No token
+// spans lines (a string literal ends at the end of its line),
+// and keyboard input is scanned as soon as each line is typed.
+// A stream is scanned by one caller at a time: the line read
+// last is kept here, between calls.
+//
+#define SCANNER_MAX_VALUE 256   // the caller's tokenValue holds this many chars
+
+static char* lineBuffer = NULL;
+static size_t lineCapacity = 0;
+static struct ScannerSource lineSource;
+static bool lineAtEOF = false;
+
+//
+// readLine
+//
+// Reads the next line of the input, through its newline, and
+// makes it the line being scanned. At the end of the input the
+// line may be empty or have no newline.
+//
+static void readLine(FILE* input) {
+    size_t length = 0;
+    int c;
+    while ((c = fgetc(input)) != EOF) {
+        if (length + 1 > lineCapacity) {
+            lineCapacity = lineCapacity == 0 ? 256 : lineCapacity * 2;
+            lineBuffer = (char*)realloc(lineBuffer, lineCapacity);
+        }
+        lineBuffer[length++] = (char)c;
+        if (c == '\n') break;
+    }
+    if (c == EOF) lineAtEOF = true;
+    scanner_openBuffer(&lineSource, length > 0 ? lineBuffer : "", length);
+}
+
+//
+// scanner_init
+//
+// Starts scanning a new stream at line 1.
+//
+void scanner_init(int* line, int* column, char* tokenValue) {
+    *line = 1;
+    *column = 0;
+    tokenValue[0] = '\0';
+    scanner_openBuffer(&lineSource, "", 0);
+    lineAtEOF = false;
+}
+
+//
+// scanner_nextToken
+//
+// Returns the next token of the input and copies its text to
+// tokenValue, reading another line whenever the current one
+// runs out. line and column track the position in the input,
+// as in scanner_nextTokenSpan. Once the end of the input or
+// $ is reached, every call returns EOS.
+//
+struct Token scanner_nextToken(FILE* input, int* line, int* column, char* tokenValue) {
+    struct Token token;
+    struct TokenSpan span;
+    for (;;) {
+        if (lineSource.pos == lineSource.end && !lineAtEOF) readLine(input);
+        lineSource.line = *line;
+        lineSource.column = *column;
+        token = scanner_nextTokenSpan(&lineSource, &span);
+        *line = lineSource.line;
+        *column = lineSource.column;
+        // an EOS at the end of a line only means the line ran out
+        if (token.id != nuPy_EOS || lineSource.pos < lineSource.end || lineAtEOF) break;
+    }
+
+    int length = span.length < SCANNER_MAX_VALUE - 1 ? span.length : SCANNER_MAX_VALUE - 1;
+    memcpy(tokenValue, span.start, (size_t)length);
+    tokenValue[length] = '\0';
+    return token;
+}
@@ -2,6 +2,8 @@
 #define SCANNER_H
 
 #include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include "token.h"
 
 // Initializes the scanner with the given line, column, and value references
@@ -10,4 +12,46 @@ void scanner_init(int* line, int* column, char* tokenValue);
 // Retrieves the next token from the input stream
 struct Token scanner_nextToken(FILE* input, int* line, int* column, char* tokenValue);
 
+// The text of a token: a span of the scanner's source, not NUL-terminated
+struct TokenSpan {
+    const char* start;
+    int length;
+};
+
+// An in-memory source for the scanner: a memory-mapped file or a caller's
+// buffer. Spans returned by scanner_nextTokenSpan stay valid until the source
+// is closed.
+struct ScannerSource {
+    const char* begin;
+    const char* end;
+    const char* pos;
+    int line;
+    int column;
+    void* mapping;
+    size_t mapping_size;
+};
+
+// Maps the given file as the scanner's source; returns false if it cannot be opened
+bool scanner_openFile(struct ScannerSource* source, const char* filename);
+
+// Uses the given buffer, which must outlive the source, as the scanner's source
+void scanner_openBuffer(struct ScannerSource* source, const char* buffer, size_t length);
+
+// Releases the source; spans into it are no longer valid
+void scanner_close(struct ScannerSource* source);
+
+// Retrieves the next token from the source, without copying its text
+struct Token scanner_nextTokenSpan(struct ScannerSource* source, struct TokenSpan* span);
+
+// A token together with its text
+struct SpanToken {
+    struct Token token;
+    struct TokenSpan span;
+};
+
+// Scans the rest of the source on up to numThreads threads (0 for one per
+// online CPU). Returns the tokens through the first EOS in a malloc'ed array,
+// exactly as repeated scanner_nextTokenSpan calls would, and sets count.
+struct SpanToken* scanner_scanParallel(struct ScannerSource* source, int numThreads, int* count);
+
 #endif // SCANNER_H
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "scanner.h"
+
+#define MAX_SCAN_THREADS 64
+
+//
+// nuPython tokens never span lines: comments and string
+// literals both stop at a newline, and every newline is
+// scanned as exactly one EOLN. So the source can be cut
+// into chunks just after any newline, and each chunk
+// scanned on its own once the line it starts on is known.
+//
+// Scanning runs in two parallel passes over the chunks. The
+// first only counts each chunk's tokens and newlines; that
+// gives every chunk its starting line and its exact slice of
+// the result, so the second pass scans again and writes the
+// tokens straight into place. Nothing is copied or resized,
+// and no thread waits on another.
+//
+struct ScanChunk {
+    struct ScannerSource source;
+    struct SpanToken* tokens;   // the chunk's slice; NULL while counting
+    int limit;                  // tokens to store; a non-final chunk's EOS is not
+    int count;
+    int newlines;
+    bool stopped;               // ended at a '$' rather than at the end of the chunk
+    const char* stop;
+};
+
+//
+// scanChunk
+//
+// Thread body: scans one chunk through the EOS at its end
+// or at a '$', counting its tokens and newlines and, on the
+// second pass, storing the tokens.
+//
+static void* scanChunk(void* arg) {
+    struct ScanChunk* chunk = (struct ScanChunk*)arg;
+    struct ScannerSource source = chunk->source;
+    struct SpanToken scanned;
+    int count = 0;
+    int newlines = 0;
+
+    do {
+        scanned.token = scanner_nextTokenSpan(&source, &scanned.span);
+        if (chunk->tokens != NULL && count < chunk->limit) chunk->tokens[count] = scanned;
+        count++;
+        if (scanned.token.id == nuPy_EOLN) newlines++;
+    } while (scanned.token.id != nuPy_EOS);
+
+    chunk->count = count;
+    chunk->newlines = newlines;
+    chunk->stopped = source.pos < source.end;
+    chunk->stop = source.pos;
+    return NULL;
+}
+
+//
+// runChunks
+//
+// Scans the given chunks concurrently, one thread each; the
+// calling thread takes the first chunk itself, and any chunk
+// whose thread cannot be started is scanned inline.
+//
+static void runChunks(struct ScanChunk* chunks, int numChunks) {
+    pthread_t threads[MAX_SCAN_THREADS];
+    bool started[MAX_SCAN_THREADS];
+
+    for (int i = 1; i < numChunks; i++)
+        started[i] = pthread_create(&threads[i], NULL, scanChunk, &chunks[i]) == 0;
+    scanChunk(&chunks[0]);
+    for (int i = 1; i < numChunks; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+        else scanChunk(&chunks[i]);
+    }
+}
+
+//
+// scanner_scanParallel
+//
+// Cuts the rest of the source into about numThreads chunks
+// at newlines and scans them concurrently. Chunks after the
+// one holding the first '$' are dropped. Tokens refer to the
+// source, which must stay open while they are in use; the
+// source is left positioned at the final EOS.
+//
+struct SpanToken* scanner_scanParallel(struct ScannerSource* source, int numThreads, int* count) {
+    if (numThreads <= 0) numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (numThreads < 1) numThreads = 1;
+    if (numThreads > MAX_SCAN_THREADS) numThreads = MAX_SCAN_THREADS;
+
+    struct ScanChunk chunks[MAX_SCAN_THREADS];
+
+    // cut just after the first newline at or past each even split point
+    size_t length = (size_t)(source->end - source->pos);
+    const char* start = source->pos;
+    int numChunks = 0;
+    while (numChunks < numThreads && (numChunks == 0 || start < source->end)) {
+        const char* cut = source->end;
+        if (numChunks < numThreads - 1) {
+            const char* target = start + length / numThreads;
+            if (target < source->end) {
+                const char* newline = (const char*)memchr(target, '\n', (size_t)(source->end - target));
+                if (newline != NULL) cut = newline + 1;
+            }
+        }
+
+        struct ScanChunk* chunk = &chunks[numChunks++];
+        scanner_openBuffer(&chunk->source, start, (size_t)(cut - start));
+        chunk->tokens = NULL;
+        start = cut;
+    }
+
+    // first pass: count, then drop the chunks after the first '$'
+    runChunks(chunks, numChunks);
+    int last = 0;
+    while (last < numChunks - 1 && !chunks[last].stopped) last++;
+    numChunks = last + 1;
+
+    // lay out each chunk's slice and starting line; the first
+    // chunk carries on from wherever the source was left
+    int total = 0;
+    int line = source->line;
+    struct SpanToken* tokens;
+    for (int i = 0; i < numChunks; i++) {
+        chunks[i].limit = (i == last) ? chunks[i].count : chunks[i].count - 1;
+        chunks[i].source.line = line;
+        chunks[i].source.column = (i == 0) ? source->column : 0;
+        total += chunks[i].limit;
+        line += chunks[i].newlines;
+    }
+    tokens = (struct SpanToken*)malloc(total * sizeof(struct SpanToken));
+    total = 0;
+    for (int i = 0; i < numChunks; i++) {
+        chunks[i].tokens = tokens + total;
+        total += chunks[i].limit;
+    }
+
+    // second pass: scan again, storing every token in place
+    runChunks(chunks, numChunks);
+
+    source->pos = chunks[last].stop;
+    source->line = tokens[total - 1].token.line;
+    source->column = tokens[total - 1].token.col - 1;
+    *count = total;
+    return tokens;
+}
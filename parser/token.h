@@ -29,6 +29,7 @@ enum TokenType {
     nuPy_KEYW_WHILE,
     nuPy_KEYW_ELIF,
     nuPy_KEYW_ELSE,
+    nuPy_KEYW_PASS,
     nuPy_LEFT_PAREN,
     nuPy_RIGHT_PAREN,
     nuPy_LEFT_BRACE,
@@ -36,7 +37,8 @@ enum TokenType {
     nuPy_COLON,
     nuPy_EQUAL,
     nuPy_EOLN,
-    nuPy_EOS
+    nuPy_EOS,
+    nuPy_UNKNOWN
 };
 
 // Struct representing a token
@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "tokenqueue.h"
+#include "intern.h"
+
+//
+// A queue is one array of compact tokens and one slab holding
+// every value, NUL-terminated, back to back. A token refers to
+// its value by slab offset, so growing the slab never leaves a
+// token dangling. Dequeuing only advances front; the memory is
+// released all at once by tokenqueue_destroy.
+//
+struct QueuedToken {
+    int id;
+    int line;
+    int col;
+    int value;      // offset of the value in the slab
+};
+
+struct TokenQueue {
+    struct QueuedToken* tokens;
+    int count;
+    int capacity;
+    int front;
+    char* slab;
+    size_t slab_used;
+    size_t slab_capacity;
+};
+
+//
+// tokenqueue_create
+//
+// Returns a new, empty token queue.
+//
+struct TokenQueue* tokenqueue_create(void) {
+    struct TokenQueue* queue = (struct TokenQueue*)malloc(sizeof(struct TokenQueue));
+    queue->capacity = 256;
+    queue->tokens = (struct QueuedToken*)malloc(queue->capacity * sizeof(struct QueuedToken));
+    queue->count = 0;
+    queue->front = 0;
+    queue->slab_capacity = 4096;
+    queue->slab = (char*)malloc(queue->slab_capacity);
+    queue->slab_used = 0;
+    return queue;
+}
+
+//
+// tokenqueue_enqueueSpan
+//
+// Appends a token, copying its value (length characters, not
+// NUL-terminated) into the slab.
+//
+void tokenqueue_enqueueSpan(struct TokenQueue* queue, struct Token token, const char* value, int length) {
+    if (queue->count == queue->capacity) {
+        queue->capacity *= 2;
+        queue->tokens = (struct QueuedToken*)realloc(queue->tokens, queue->capacity * sizeof(struct QueuedToken));
+    }
+    if (queue->slab_used + length + 1 > queue->slab_capacity) {
+        while (queue->slab_used + length + 1 > queue->slab_capacity) queue->slab_capacity *= 2;
+        queue->slab = (char*)realloc(queue->slab, queue->slab_capacity);
+    }
+
+    struct QueuedToken* queued = &queue->tokens[queue->count++];
+    queued->id = token.id;
+    queued->line = token.line;
+    queued->col = token.col;
+    queued->value = (int)queue->slab_used;
+
+    memcpy(queue->slab + queue->slab_used, value, length);
+    queue->slab[queue->slab_used + length] = '\0';
+    queue->slab_used += length + 1;
+}
+
+//
+// tokenqueue_enqueue
+//
+// Appends a token, copying its value into the slab.
+//
+void tokenqueue_enqueue(struct TokenQueue* queue, struct Token token, const char* value) {
+    tokenqueue_enqueueSpan(queue, token, value, (int)strlen(value));
+}
+
+//
+// tokenqueue_duplicate
+//
+// Returns a copy of the tokens still in the queue.
+//
+struct TokenQueue* tokenqueue_duplicate(struct TokenQueue* queue) {
+    struct TokenQueue* duplicate = tokenqueue_create();
+    for (int i = queue->front; i < queue->count; i++) {
+        struct Token token = { queue->tokens[i].id, queue->tokens[i].line, queue->tokens[i].col };
+        tokenqueue_enqueue(duplicate, token, queue->slab + queue->tokens[i].value);
+    }
+    return duplicate;
+}
+
+//
+// tokenqueue_at
+//
+// Returns the token at the given position, or the last token
+// for any position past the end (the last token is always
+// EOS in a queue built by the parser).
+//
+static struct QueuedToken* tokenqueue_at(struct TokenQueue* queue, int position) {
+    static struct QueuedToken none = { nuPy_EOS, 0, 0, -1 };
+    if (queue->count == 0) return &none;
+    if (position >= queue->count) position = queue->count - 1;
+    return &queue->tokens[position];
+}
+
+static struct Token tokenqueue_token(struct QueuedToken* queued) {
+    struct Token token = { queued->id, queued->line, queued->col };
+    return token;
+}
+
+static char* tokenqueue_value(struct TokenQueue* queue, struct QueuedToken* queued) {
+    if (queued->value < 0) return "$";
+    return queue->slab + queued->value;
+}
+
+struct Token tokenqueue_peekToken(struct TokenQueue* queue) {
+    return tokenqueue_token(tokenqueue_at(queue, queue->front));
+}
+
+struct Token tokenqueue_peek2Token(struct TokenQueue* queue) {
+    return tokenqueue_token(tokenqueue_at(queue, queue->front + 1));
+}
+
+char* tokenqueue_peekValue(struct TokenQueue* queue) {
+    return tokenqueue_value(queue, tokenqueue_at(queue, queue->front));
+}
+
+//
+// tokenqueue_dequeue
+//
+// Removes the token at the front of the queue; the last token
+// is never removed.
+//
+void tokenqueue_dequeue(struct TokenQueue* queue) {
+    if (queue->front < queue->count - 1) queue->front++;
+}
+
+//
+// tokenqueue_destroy
+//
+// Frees the queue, its tokens and all of their values.
+//
+void tokenqueue_destroy(struct TokenQueue* queue) {
+    if (queue == NULL) return;
+    free(queue->tokens);
+    free(queue->slab);
+    free(queue);
+}
+
+//
+// tokenqueue_cursor
+//
+// Returns a cursor at the front of the queue. Values read
+// through a cursor stay valid until the queue is destroyed
+// or another token is enqueued.
+//
+struct TokenCursor tokenqueue_cursor(struct TokenQueue* queue) {
+    struct TokenCursor cursor;
+    memset(&cursor, 0, sizeof(cursor));
+    cursor.queue = queue;
+    cursor.position = queue->front;
+    return cursor;
+}
+
+//
+// tokencursor_stream
+//
+// Returns a streaming cursor; no token is fetched until the
+// first peek. Values read through a streaming cursor stay
+// valid until it is next advanced.
+//
+struct TokenCursor tokencursor_stream(TokenFetch fetch, void* state, struct TokenQueue* record) {
+    struct TokenCursor cursor;
+    memset(&cursor, 0, sizeof(cursor));
+    cursor.fetch = fetch;
+    cursor.state = state;
+    cursor.record = record;
+    for (int i = 0; i < 2; i++) {
+        cursor.capacities[i] = 64;
+        cursor.buffers[i] = (char*)malloc(cursor.capacities[i]);
+    }
+    return cursor;
+}
+
+void tokencursor_close(struct TokenCursor* cursor) {
+    if (cursor->queue != NULL) return;
+    for (int i = 0; i < 2; i++) {
+        free(cursor->buffers[i]);
+        cursor->buffers[i] = NULL;
+    }
+}
+
+// identifiers and literals are the values the program graph keeps
+static bool isInterned(int tokenID) {
+    return tokenID == nuPy_IDENTIFIER || tokenID == nuPy_INT_LITERAL || tokenID == nuPy_REAL_LITERAL ||
+           tokenID == nuPy_STR_LITERAL || tokenID == nuPy_KEYW_TRUE || tokenID == nuPy_KEYW_FALSE ||
+           tokenID == nuPy_KEYW_NONE;
+}
+
+//
+// tokencursor_fill
+//
+// Makes sure a streaming cursor's window holds at least
+// count tokens. Once EOS has been fetched, the source is
+// not asked again (it may be the keyboard); the window is
+// padded with copies of the EOS instead.
+//
+static void tokencursor_fill(struct TokenCursor* cursor, int count) {
+    while (cursor->buffered < count) {
+        int slot = cursor->buffered;
+        const char* value;
+        int length;
+        struct Token token;
+
+        if (slot > 0 && cursor->window[slot - 1].id == nuPy_EOS) {
+            token = cursor->window[slot - 1];
+            value = cursor->values[slot - 1];
+            length = (int)strlen(value);
+        }
+        else {
+            token = cursor->fetch(cursor->state, &value, &length);
+            if (cursor->record != NULL) tokenqueue_enqueueSpan(cursor->record, token, value, length);
+        }
+
+        cursor->window[slot] = token;
+        cursor->buffered++;
+        cursor->interned[slot] = cursor->interns != NULL && isInterned(token.id);
+        if (cursor->interned[slot]) {
+            cursor->values[slot] = intern_span(cursor->interns, value, length);
+            continue;
+        }
+
+        if (length + 1 > cursor->capacities[slot]) {
+            while (length + 1 > cursor->capacities[slot]) cursor->capacities[slot] *= 2;
+            cursor->buffers[slot] = (char*)realloc(cursor->buffers[slot], cursor->capacities[slot]);
+        }
+        memmove(cursor->buffers[slot], value, length);
+        cursor->buffers[slot][length] = '\0';
+        cursor->values[slot] = cursor->buffers[slot];
+    }
+}
+
+struct Token tokencursor_peek(struct TokenCursor* cursor) {
+    if (cursor->queue == NULL) {
+        tokencursor_fill(cursor, 1);
+        return cursor->window[0];
+    }
+    return tokenqueue_token(tokenqueue_at(cursor->queue, cursor->position));
+}
+
+struct Token tokencursor_peek2(struct TokenCursor* cursor) {
+    if (cursor->queue == NULL) {
+        tokencursor_fill(cursor, 2);
+        return cursor->window[1];
+    }
+    return tokenqueue_token(tokenqueue_at(cursor->queue, cursor->position + 1));
+}
+
+char* tokencursor_value(struct TokenCursor* cursor) {
+    if (cursor->queue == NULL) {
+        tokencursor_fill(cursor, 1);
+        return cursor->values[0];
+    }
+    return tokenqueue_value(cursor->queue, tokenqueue_at(cursor->queue, cursor->position));
+}
+
+//
+// tokencursor_intern
+//
+// Returns the current value interned in the cursor's table,
+// which must be set.
+//
+char* tokencursor_intern(struct TokenCursor* cursor) {
+    if (cursor->queue == NULL) {
+        tokencursor_fill(cursor, 1);
+        if (cursor->interned[0]) return cursor->values[0];
+    }
+    return intern_string(cursor->interns, tokencursor_value(cursor));
+}
+
+void tokencursor_advance(struct TokenCursor* cursor) {
+    if (cursor->queue == NULL) {
+        tokencursor_fill(cursor, 1);
+        if (cursor->window[0].id == nuPy_EOS) return;
+
+        // slide the window, keeping both value buffers
+        char* buffer = cursor->buffers[0];
+        int capacity = cursor->capacities[0];
+        cursor->window[0] = cursor->window[1];
+        cursor->values[0] = cursor->values[1];
+        cursor->interned[0] = cursor->interned[1];
+        cursor->buffers[0] = cursor->buffers[1];
+        cursor->capacities[0] = cursor->capacities[1];
+        cursor->buffers[1] = buffer;
+        cursor->capacities[1] = capacity;
+        cursor->buffered--;
+        cursor->position++;
+        return;
+    }
+    if (cursor->position < cursor->queue->count - 1) cursor->position++;
+}
@@ -1,9 +1,48 @@
 #ifndef TOKENQUEUE_H
 #define TOKENQUEUE_H
 
+#include <stdbool.h>
+
 #include "token.h"
 
 struct TokenQueue;
+struct INTERN_TABLE;
+struct LAZY_SOURCE;
+
+// Supplies tokens to a streaming cursor: returns the next token and points
+// value at its text (length characters, not NUL-terminated), which only needs
+// to stay valid until the next call
+typedef struct Token (*TokenFetch)(void* state, const char** value, int* length);
+
+// A read position in a token queue. Peeking and advancing a cursor leaves the
+// queue itself untouched, so any number of cursors can walk the same queue.
+//
+// A streaming cursor (queue is NULL) has no queue behind it: it pulls tokens
+// from fetch on demand into a two-token window, so it needs constant memory
+// however long the input is. If record is not NULL, every token pulled is
+// also enqueued there.
+//
+// If interns is set, tokencursor_intern returns the current value interned
+// in that table. A streaming cursor interns identifiers and literals as it
+// pulls them, straight from the fetched text.
+//
+// If lazy is set, the parser defers the blocks it reads through this cursor
+// (see parser_parseProgramLazy); it is only ever set on a queue cursor.
+struct TokenCursor {
+    struct TokenQueue* queue;
+    int position;
+    TokenFetch fetch;
+    void* state;
+    struct TokenQueue* record;
+    struct INTERN_TABLE* interns;
+    struct LAZY_SOURCE* lazy;
+    int buffered;
+    struct Token window[2];
+    char* values[2];       // the window's values: interned, or in buffers
+    bool interned[2];
+    char* buffers[2];
+    int capacities[2];
+};
 
 // Creates a new token queue
 struct TokenQueue* tokenqueue_create(void);
@@ -11,6 +50,9 @@ struct TokenQueue* tokenqueue_create(void);
 // Enqueues a token in the queue
 void tokenqueue_enqueue(struct TokenQueue* queue, struct Token token, const char* value);
 
+// Enqueues a token whose value is the given (not NUL-terminated) text
+void tokenqueue_enqueueSpan(struct TokenQueue* queue, struct Token token, const char* value, int length);
+
 // Duplicates a token queue
 struct TokenQueue* tokenqueue_duplicate(struct TokenQueue* queue);
 
@@ -29,4 +71,28 @@ void tokenqueue_dequeue(struct TokenQueue* queue);
 // Destroys a token queue and frees associated memory
 void tokenqueue_destroy(struct TokenQueue* queue);
 
+// Returns a cursor at the front of the queue
+struct TokenCursor tokenqueue_cursor(struct TokenQueue* queue);
+
+// Returns a streaming cursor over the tokens supplied by fetch
+struct TokenCursor tokencursor_stream(TokenFetch fetch, void* state, struct TokenQueue* record);
+
+// Frees a streaming cursor's window; does nothing for a queue cursor
+void tokencursor_close(struct TokenCursor* cursor);
+
+// Peeks at the token at the cursor
+struct Token tokencursor_peek(struct TokenCursor* cursor);
+
+// Peeks at the token after the one at the cursor
+struct Token tokencursor_peek2(struct TokenCursor* cursor);
+
+// Gets the value of the token at the cursor
+char* tokencursor_value(struct TokenCursor* cursor);
+
+// Gets the value of the token at the cursor, interned in the cursor's table
+char* tokencursor_intern(struct TokenCursor* cursor);
+
+// Moves the cursor to the next token; the cursor never moves past the last token
+void tokencursor_advance(struct TokenCursor* cursor);
+
 #endif // TOKENQUEUE_H
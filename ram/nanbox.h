@@ -0,0 +1,122 @@
+#ifndef NANBOX_H
+#define NANBOX_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "ram.h"
+
+//
+// NaN-boxed values
+//
+// A RAM_BOX packs a RAM_VALUE into 8 bytes. Any real is stored as its own
+// IEEE-754 bit pattern, except that NaNs are canonicalized to a positive
+// quiet NaN. Every other type lives in the space of negative quiet NaNs,
+// which no real can occupy after canonicalization:
+//
+//   1111 1111 1111 1ttt  pppp ... pppp
+//   |-- 13 bits --||tag| |- 48-bit payload -|
+//
+// ints, booleans and pointers keep their 32-bit value in the low payload
+// bits; strings keep their RAM_STR pointer, which fits in 48 bits on the
+// 64-bit targets we support.
+//
+
+_Static_assert(sizeof(void*) == 8, "NaN-boxing requires 64-bit pointers");
+
+#define RAM_BOX_QNAN          0xFFF8000000000000ull
+#define RAM_BOX_CANONICAL_NAN 0x7FF8000000000000ull
+#define RAM_BOX_TAG_SHIFT     48
+#define RAM_BOX_TAG_MASK      (7ull << RAM_BOX_TAG_SHIFT)
+#define RAM_BOX_PAYLOAD_MASK  0x0000FFFFFFFFFFFFull
+
+// Tags 1-6 select a non-real type; tag 0 is never produced, so the
+// negative quiet NaN 0xFFF8000000000000 is not a valid box either
+enum RAM_BOX_TAG {
+    RAM_BOX_TAG_NONE = 1,
+    RAM_BOX_TAG_BOOLEAN,
+    RAM_BOX_TAG_INT,
+    RAM_BOX_TAG_PTR,
+    RAM_BOX_TAG_STR,
+    RAM_BOX_TAG_UNDEFINED
+};
+
+static inline RAM_BOX ram_box_tagged(enum RAM_BOX_TAG tag, uint64_t payload) {
+    return RAM_BOX_QNAN | ((uint64_t)tag << RAM_BOX_TAG_SHIFT) | (payload & RAM_BOX_PAYLOAD_MASK);
+}
+
+static inline bool ram_box_is_real(RAM_BOX box) {
+    return (box & RAM_BOX_QNAN) != RAM_BOX_QNAN;
+}
+
+static inline enum RAM_BOX_TAG ram_box_tag(RAM_BOX box) {
+    return (enum RAM_BOX_TAG)((box & RAM_BOX_TAG_MASK) >> RAM_BOX_TAG_SHIFT);
+}
+
+static inline RAM_BOX ram_box_real(double d) {
+    RAM_BOX box;
+    if (d != d) return RAM_BOX_CANONICAL_NAN;
+    memcpy(&box, &d, sizeof(box));
+    return box;
+}
+
+static inline RAM_BOX ram_box_int(int i) { return ram_box_tagged(RAM_BOX_TAG_INT, (uint32_t)i); }
+static inline RAM_BOX ram_box_bool(int b) { return ram_box_tagged(RAM_BOX_TAG_BOOLEAN, (uint32_t)b); }
+static inline RAM_BOX ram_box_ptr(int p) { return ram_box_tagged(RAM_BOX_TAG_PTR, (uint32_t)p); }
+static inline RAM_BOX ram_box_none(void) { return ram_box_tagged(RAM_BOX_TAG_NONE, 0); }
+static inline RAM_BOX ram_box_undefined(void) { return ram_box_tagged(RAM_BOX_TAG_UNDEFINED, 0); }
+static inline RAM_BOX ram_box_str(struct RAM_STR* str) { return ram_box_tagged(RAM_BOX_TAG_STR, (uint64_t)(uintptr_t)str); }
+
+static inline double ram_box_as_real(RAM_BOX box) {
+    double d;
+    memcpy(&d, &box, sizeof(d));
+    return d;
+}
+
+static inline int ram_box_as_int(RAM_BOX box) { return (int)(uint32_t)box; }
+static inline struct RAM_STR* ram_box_as_str(RAM_BOX box) { return (struct RAM_STR*)(uintptr_t)(box & RAM_BOX_PAYLOAD_MASK); }
+
+// Both operands are ints: a single compare per operand, no unboxing
+static inline bool ram_box_both_int(RAM_BOX lhs, RAM_BOX rhs) {
+    const uint64_t int_prefix = RAM_BOX_QNAN | ((uint64_t)RAM_BOX_TAG_INT << RAM_BOX_TAG_SHIFT);
+    return (lhs & ~RAM_BOX_PAYLOAD_MASK) == int_prefix && (rhs & ~RAM_BOX_PAYLOAD_MASK) == int_prefix;
+}
+
+// Returns the RAM_VALUE_TYPE of a box
+static inline RAM_VALUE_TYPE ram_box_type(RAM_BOX box) {
+    if (ram_box_is_real(box)) return RAM_TYPE_REAL;
+    switch (ram_box_tag(box)) {
+        case RAM_BOX_TAG_BOOLEAN: return RAM_TYPE_BOOLEAN;
+        case RAM_BOX_TAG_INT: return RAM_TYPE_INT;
+        case RAM_BOX_TAG_PTR: return RAM_TYPE_PTR;
+        case RAM_BOX_TAG_STR: return RAM_TYPE_STR;
+        case RAM_BOX_TAG_UNDEFINED: return RAM_TYPE_UNDEFINED;
+        default: return RAM_TYPE_NONE;
+    }
+}
+
+// Converts a RAM_VALUE to a box; a string box borrows the value's reference
+static inline RAM_BOX ram_box_from_value(struct RAM_VALUE value) {
+    switch (value.value_type) {
+        case RAM_TYPE_INT: return ram_box_int(value.types.i);
+        case RAM_TYPE_REAL: return ram_box_real(value.types.d);
+        case RAM_TYPE_STR: return ram_box_str(value.types.str);
+        case RAM_TYPE_PTR: return ram_box_ptr(value.types.i);
+        case RAM_TYPE_BOOLEAN: return ram_box_bool(value.types.i);
+        case RAM_TYPE_UNDEFINED: return ram_box_undefined();
+        default: return ram_box_none();
+    }
+}
+
+// Converts a box back to a RAM_VALUE; a string value borrows the box's reference
+static inline struct RAM_VALUE ram_box_to_value(RAM_BOX box) {
+    struct RAM_VALUE value;
+    value.value_type = ram_box_type(box);
+    if (value.value_type == RAM_TYPE_REAL) value.types.d = ram_box_as_real(box);
+    else if (value.value_type == RAM_TYPE_STR) value.types.str = ram_box_as_str(box);
+    else value.types.i = ram_box_as_int(box);
+    return value;
+}
+
+#endif // NANBOX_H
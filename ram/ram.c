@@ -2,9 +2,436 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <limits.h>
 #include <assert.h>
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "ram.h"
+#include "nanbox.h"
+
+#define RAM_IMAGE_MAGIC "NUPYRAM"
+#define RAM_IMAGE_VERSION 3
+
+//
+// Statistics: RAM_COUNT adds to one of the memory's counters,
+// and compiles to nothing when RAM_NO_STATS is defined. Strings
+// are shared between memories, so their bytes are counted once,
+// globally.
+//
+#ifdef RAM_NO_STATS
+#define RAM_COUNT(memory, counter, n) ((void)0)
+#else
+#define RAM_COUNT(memory, counter, n) ((memory)->stats.counter += (n))
+static long ram_string_bytes = 0;
+#endif
+
+//
+// Layout of a RAM image written by ram_snapshot: a header, one
+// record per cell, the identifiers (NUL-terminated), and then
+// each string as a RAM_STR with refcount RAM_STR_STATIC, 8-byte
+// aligned. Offsets are from the start of the image. Images use
+// the native byte order and are not portable across platforms.
+//
+struct RAM_IMAGE_HEADER {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_values;
+  uint64_t size;
+  uint32_t defined_capacity;  // what ram_print reports as the capacity
+};
+
+struct RAM_IMAGE_CELL {
+  uint32_t value_type;
+  uint32_t hash;
+  uint64_t identifier;  // offset of the identifier
+  union {
+    int64_t i;
+    double d;
+    uint64_t str;       // offset of the RAM_STR
+  } value;
+  int32_t sequence;     // renumbered from 0 in definition order; -1 if undefined
+};
+
+//
+// ram_str_create
+//
+// Returns a new string holding a copy of the given
+// characters, with a reference count of 1. The caller
+// owns that reference and must release it.
+//
+struct RAM_STR* ram_str_create(const char* chars, int length)
+{
+  struct RAM_STR* str = (struct RAM_STR*)malloc(sizeof(struct RAM_STR) + length + 1);
+#ifndef RAM_NO_STATS
+  ram_string_bytes += sizeof(struct RAM_STR) + length + 1;
+#endif
+  str->refcount = 1;
+  str->length = length;
+  memcpy(str->chars, chars, length);
+  str->chars[length] = '\0';
+  return str;
+}
+
+
+//
+// ram_str_concat
+//
+// Returns a new string (reference count 1) holding lhs
+// followed by rhs.
+//
+struct RAM_STR* ram_str_concat(struct RAM_STR* lhs, struct RAM_STR* rhs)
+{
+  int length = lhs->length + rhs->length;
+  struct RAM_STR* str = (struct RAM_STR*)malloc(sizeof(struct RAM_STR) + length + 1);
+#ifndef RAM_NO_STATS
+  ram_string_bytes += sizeof(struct RAM_STR) + length + 1;
+#endif
+  str->refcount = 1;
+  str->length = length;
+  memcpy(str->chars, lhs->chars, lhs->length);
+  memcpy(str->chars + lhs->length, rhs->chars, rhs->length + 1);
+  return str;
+}
+
+
+//
+// ram_str_retain
+//
+// Adds a reference to the given string and returns it.
+//
+struct RAM_STR* ram_str_retain(struct RAM_STR* str)
+{
+  if (str->refcount != RAM_STR_STATIC) str->refcount++;
+  return str;
+}
+
+
+//
+// ram_str_release
+//
+// Drops a reference to the given string, freeing it
+// when the last reference is released.
+//
+void ram_str_release(struct RAM_STR* str)
+{
+  if (str == NULL || str->refcount == RAM_STR_STATIC) return;
+  if (--str->refcount == 0) free(str);
+}
+
+
+//
+// ram_update_footprint
+//
+// Recomputes the bytes held by the memory itself (cells, index,
+// overrides and identifiers, but not the shared strings) and
+// tracks the peak. Called whenever any of those grow.
+//
+static void ram_update_footprint(struct RAM* memory)
+{
+#ifndef RAM_NO_STATS
+#ifdef RAM_NANBOX
+  size_t cell_size = sizeof(RAM_BOX);
+#else
+  size_t cell_size = sizeof(unsigned char) + sizeof(union RAM_PAYLOAD);
+#endif
+  size_t bytes = sizeof(struct RAM)
+               + (size_t)memory->capacity * (cell_size + sizeof(char*) + sizeof(unsigned int) + sizeof(int))
+               + (size_t)memory->index_capacity * sizeof(int)
+               + (size_t)memory->override_capacity * (2 * sizeof(int) + sizeof(struct RAM_VALUE))
+               + memory->names->bytes_allocated;
+  memory->stats.footprint = (long)bytes;
+  if (memory->stats.footprint > memory->stats.peak_footprint) memory->stats.peak_footprint = memory->stats.footprint;
+#else
+  (void)memory;
+#endif
+}
+
+
+//
+// ram_count_probes
+//
+// Records the number of index slots examined by one lookup.
+//
+static inline void ram_count_probes(struct RAM* memory, long probes)
+{
+#ifndef RAM_NO_STATS
+  memory->stats.lookups++;
+  memory->stats.lookup_probes += probes;
+  if (probes > memory->stats.max_probe_length) memory->stats.max_probe_length = probes;
+#else
+  (void)memory;
+  (void)probes;
+#endif
+}
+
+
+static struct RAM_VALUE ram_shared_load(struct RAM* memory, int address);
+
+
+//
+// ram_cell_load
+//
+// Returns the value stored in the cell at the given address,
+// decoding it when cells are NaN-boxed. No reference is taken.
+//
+static inline struct RAM_VALUE ram_cell_load(struct RAM* memory, int address)
+{
+  if (address < memory->base) return ram_shared_load(memory, address);
+  address -= memory->base;
+#ifdef RAM_NANBOX
+  return ram_box_to_value(memory->boxes[address]);
+#else
+  struct RAM_VALUE value;
+  value.value_type = (RAM_VALUE_TYPE)memory->types[address];
+  value.types = memory->payloads[address];
+  return value;
+#endif
+}
+
+
+//
+// ram_cell_store
+//
+// Stores the value in the cell at the given address, encoding
+// it when cells are NaN-boxed. No reference is taken or dropped.
+// The cell must belong to this memory, not to a fork's parent.
+//
+static inline void ram_cell_store(struct RAM* memory, int address, struct RAM_VALUE value)
+{
+  assert(address >= memory->base);
+  address -= memory->base;
+#ifdef RAM_NANBOX
+  memory->boxes[address] = ram_box_from_value(value);
+#else
+  memory->types[address] = (unsigned char)value.value_type;
+  memory->payloads[address] = value.types;
+#endif
+}
+
+
+//
+// ram_cell_type
+//
+// Returns the type of the value in the cell at the given address.
+//
+static inline RAM_VALUE_TYPE ram_cell_type(struct RAM* memory, int address)
+{
+  if (address < memory->base) return ram_shared_load(memory, address).value_type;
+  address -= memory->base;
+#ifdef RAM_NANBOX
+  return ram_box_type(memory->boxes[address]);
+#else
+  return (RAM_VALUE_TYPE)memory->types[address];
+#endif
+}
+
+
+//
+// ram_cell_identifier
+//
+// Returns the identifier naming the cell at the given address.
+//
+static char* ram_cell_identifier(struct RAM* memory, int address)
+{
+  if (address < memory->base) return ram_cell_identifier(memory->parent, address);
+  return memory->identifiers[address - memory->base];
+}
+
+
+//
+// ram_cell_hash
+//
+// Returns the stored hash of the cell's identifier.
+//
+static unsigned int ram_cell_hash(struct RAM* memory, int address)
+{
+  if (address < memory->base) return ram_cell_hash(memory->parent, address);
+  return memory->hashes[address - memory->base];
+}
+
+
+//
+// ram_override_slot
+//
+// Returns the slot of the overrides table holding the given
+// shared address, or the empty slot where it would go. The
+// table must not be empty.
+//
+static int ram_override_slot(struct RAM* memory, int address)
+{
+  int mask = memory->override_capacity - 1;
+  int slot = (int)(((unsigned int)address * 2654435761u) & (unsigned int)mask);
+  while (memory->overrides[slot] != -1 && memory->overrides[slot] != address) slot = (slot + 1) & mask;
+  return slot;
+}
+
+
+//
+// ram_shared_load
+//
+// Returns the value of a cell shared with the parent: the
+// fork's own copy if it has written the cell, otherwise the
+// parent's value.
+//
+static struct RAM_VALUE ram_shared_load(struct RAM* memory, int address)
+{
+  if (memory->num_overrides > 0) {
+    int slot = ram_override_slot(memory, address);
+    if (memory->overrides[slot] == address) return memory->override_values[slot];
+  }
+  return ram_cell_load(memory->parent, address);
+}
+
+
+//
+// ram_cell_sequence
+//
+// Returns the sequence number of the cell at the given address:
+// when it was first written, or -1 if it has not been yet. A
+// shared cell that the parent only reserved may have been first
+// written by the fork.
+//
+static int ram_cell_sequence(struct RAM* memory, int address)
+{
+  if (address >= memory->base) return memory->sequence[address - memory->base];
+  if (memory->num_overrides > 0) {
+    int slot = ram_override_slot(memory, address);
+    if (memory->overrides[slot] == address && memory->override_sequence[slot] != -1) return memory->override_sequence[slot];
+  }
+  return ram_cell_sequence(memory->parent, address);
+}
+
+
+//
+// ram_grow_overrides
+//
+// Doubles the overrides table (or creates it) and reinserts
+// the existing overrides.
+//
+static void ram_grow_overrides(struct RAM* memory)
+{
+  int* old_overrides = memory->overrides;
+  struct RAM_VALUE* old_values = memory->override_values;
+  int* old_sequence = memory->override_sequence;
+  int old_capacity = memory->override_capacity;
+
+  memory->override_capacity = old_capacity == 0 ? 8 : old_capacity * 2;
+  memory->overrides = (int*)malloc(memory->override_capacity * sizeof(int));
+  memory->override_values = (struct RAM_VALUE*)malloc(memory->override_capacity * sizeof(struct RAM_VALUE));
+  memory->override_sequence = (int*)malloc(memory->override_capacity * sizeof(int));
+  for (int i = 0; i < memory->override_capacity; i++) memory->overrides[i] = -1;
+
+  for (int i = 0; i < old_capacity; i++) {
+    if (old_overrides[i] == -1) continue;
+    int slot = ram_override_slot(memory, old_overrides[i]);
+    memory->overrides[slot] = old_overrides[i];
+    memory->override_values[slot] = old_values[i];
+    memory->override_sequence[slot] = old_sequence[i];
+  }
+  free(old_overrides);
+  free(old_values);
+  free(old_sequence);
+  ram_update_footprint(memory);
+}
+
+
+//
+// ram_cell_set_type
+//
+// Stores a value of the given payload-free type (None or
+// undefined) in the cell at the given address.
+//
+static inline void ram_cell_set_type(struct RAM* memory, int address, RAM_VALUE_TYPE type)
+{
+  struct RAM_VALUE value;
+  value.value_type = type;
+  value.types.i = 0;
+  ram_cell_store(memory, address, value);
+}
+
+
+//
+// ram_resize_cells
+//
+// Resizes every per-cell array to the given capacity. Cells
+// past num_values are unnamed and hold None.
+//
+static void ram_resize_cells(struct RAM* memory, int capacity)
+{
+#ifdef RAM_NANBOX
+  memory->boxes = (RAM_BOX*)realloc(memory->boxes, capacity * sizeof(RAM_BOX));
+#else
+  memory->types = (unsigned char*)realloc(memory->types, capacity * sizeof(unsigned char));
+  memory->payloads = (union RAM_PAYLOAD*)realloc(memory->payloads, capacity * sizeof(union RAM_PAYLOAD));
+#endif
+  memory->identifiers = (char**)realloc(memory->identifiers, capacity * sizeof(char*));
+  memory->hashes = (unsigned int*)realloc(memory->hashes, capacity * sizeof(unsigned int));
+  memory->sequence = (int*)realloc(memory->sequence, capacity * sizeof(int));
+
+  for (int i = memory->num_values - memory->base; i < capacity; i++) {
+    memory->identifiers[i] = NULL;
+    memory->hashes[i] = 0;
+    memory->sequence[i] = -1;
+    ram_cell_set_type(memory, memory->base + i, RAM_TYPE_NONE);
+  }
+  memory->capacity = capacity;
+}
+
+
+//
+// ram_hash
+//
+// Returns the FNV-1a hash of the given identifier. Hashes
+// are computed once per lookup and stored per cell, so
+// the index never has to rehash identifiers when it grows.
+//
+static unsigned int ram_hash(char* identifier)
+{
+  unsigned int hash = 2166136261u;
+  for (unsigned char* p = (unsigned char*)identifier; *p != '\0'; p++) {
+    hash ^= *p;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+
+//
+// ram_index_insert
+//
+// Inserts the given cell (an address relative to base) into
+// the hash index, probing linearly from the cell's precomputed
+// hash. The caller guarantees the identifier is not already
+// indexed.
+//
+static void ram_index_insert(struct RAM* memory, int cell)
+{
+  int mask = memory->index_capacity - 1;
+  int slot = (int)(memory->hashes[cell] & (unsigned int)mask);
+  while (memory->index[slot] != -1) slot = (slot + 1) & mask;
+  memory->index[slot] = cell;
+}
+
+
+//
+// ram_index_rebuild
+//
+// Resizes the hash index to twice the cell capacity and
+// reinserts every cell using its stored hash.
+//
+static void ram_index_rebuild(struct RAM* memory)
+{
+  free(memory->index);
+  memory->index_capacity = memory->capacity * 2;
+  memory->index = (int*)malloc(memory->index_capacity * sizeof(int));
+  for (int i = 0; i < memory->index_capacity; i++) memory->index[i] = -1;
+  for (int i = 0; i < memory->num_values - memory->base; i++) ram_index_insert(memory, i);
+}
+
 
 //
 // ram_init
@@ -17,13 +444,36 @@ struct RAM* ram_init(void)
 {
   struct RAM* ram = (struct RAM*)malloc(sizeof(struct RAM));
   ram->num_values = 0;
-  ram->capacity = 4;
-  ram->cells = (struct RAM_CELL*)malloc(ram->capacity * sizeof(struct RAM_CELL));
+#ifdef RAM_NANBOX
+  ram->boxes = NULL;
+#else
+  ram->types = NULL;
+  ram->payloads = NULL;
+#endif
+  ram->identifiers = NULL;
+  ram->hashes = NULL;
+  ram->sequence = NULL;
+  ram->next_sequence = 0;
+  ram->num_defined = 0;
+  ram->defined_capacity = 4;
+  ram->parent = NULL;
+  ram->base = 0;
+  ram->num_forks = 0;
+  ram->overrides = NULL;
+  ram->override_values = NULL;
+  ram->override_sequence = NULL;
+  ram->num_overrides = 0;
+  ram->override_capacity = 0;
+  ram_resize_cells(ram, 4);
+  ram->image = NULL;
+  ram->image_size = 0;
 
-  for (int i = 0; i < ram->capacity; i++) {
-    ram->cells[i].identifier = NULL;
-    ram->cells[i].value.value_type = RAM_TYPE_NONE;
-  }
+  ram->index = NULL;
+  ram_index_rebuild(ram);
+  ram->names = arena_init();
+
+  memset(&ram->stats, 0, sizeof(ram->stats));
+  ram_update_footprint(ram);
   
   return ram;
 }
@@ -33,20 +483,158 @@ struct RAM* ram_init(void)
 // ram_destroy
 //
 // Frees the dynamically-allocated memory associated with
-// the given memory.
+// the given memory. Identifiers live in the names arena
+// and are freed in bulk; only strings, which may still be
+// shared elsewhere, are released cell by cell. Forks must
+// be destroyed before their parent.
 //
 void ram_destroy(struct RAM* memory)
 {
-  for (int i = 0; i < memory->num_values; i++) {
-    if (memory->cells[i].value.value_type == RAM_TYPE_STR) free(memory->cells[i].value.types.s);
-    free(memory->cells[i].identifier);
+  assert(memory->num_forks == 0);
+
+  for (int i = memory->base; i < memory->num_values; i++) {
+    if (ram_cell_type(memory, i) == RAM_TYPE_STR) ram_str_release(ram_cell_load(memory, i).types.str);
+  }
+  for (int i = 0; i < memory->override_capacity; i++) {
+    if (memory->overrides[i] != -1 && memory->override_values[i].value_type == RAM_TYPE_STR)
+      ram_str_release(memory->override_values[i].types.str);
   }
-  free(memory->cells);
+  if (memory->parent != NULL) memory->parent->num_forks--;
+
+  arena_destroy(memory->names);
+#ifdef RAM_NANBOX
+  free(memory->boxes);
+#else
+  free(memory->types);
+  free(memory->payloads);
+#endif
+  free(memory->identifiers);
+  free(memory->hashes);
+  free(memory->sequence);
+  if (memory->image != NULL) munmap(memory->image, memory->image_size);
+  free(memory->overrides);
+  free(memory->override_values);
+  free(memory->override_sequence);
+  free(memory->index);
   free(memory);
   return;
 }
 
 
+//
+// ram_fork
+//
+// Returns a new memory that starts out with the same cells,
+// at the same addresses, as the given parent. Nothing is
+// copied: the fork reads the parent's cells in place and
+// copies a cell only when it is first written, so a fork
+// costs O(1) to create and grows only with what it changes.
+// The parent is frozen (all writes to it fail) until every
+// fork of it has been destroyed.
+//
+struct RAM* ram_fork(struct RAM* parent)
+{
+  struct RAM* fork = (struct RAM*)malloc(sizeof(struct RAM));
+  fork->num_values = parent->num_values;
+  fork->capacity = 0;
+#ifdef RAM_NANBOX
+  fork->boxes = NULL;
+#else
+  fork->types = NULL;
+  fork->payloads = NULL;
+#endif
+  fork->identifiers = NULL;
+  fork->hashes = NULL;
+  fork->sequence = NULL;
+  fork->next_sequence = parent->next_sequence;
+  fork->num_defined = 0;
+  fork->defined_capacity = 0;
+  fork->index = NULL;
+  fork->index_capacity = 0;
+  fork->names = arena_init();
+  fork->image = NULL;
+  fork->image_size = 0;
+  fork->parent = parent;
+  fork->base = parent->num_values;
+  fork->num_forks = 0;
+  fork->overrides = NULL;
+  fork->override_values = NULL;
+  fork->override_sequence = NULL;
+  fork->num_overrides = 0;
+  fork->override_capacity = 0;
+  memset(&fork->stats, 0, sizeof(fork->stats));
+  ram_update_footprint(fork);
+
+  parent->num_forks++;
+  return fork;
+}
+
+
+//
+// ram_find
+//
+// Returns the address of the cell named by the given
+// identifier, whether or not it has been written yet,
+// or -1 if no such cell exists. Lookup goes through the
+// hash index, so the cost does not grow with the number
+// of cells. A fork searches its own cells, then its
+// parent's.
+//
+static int ram_find(struct RAM* memory, char* identifier, unsigned int hash)
+{
+  if (memory->index_capacity > 0) {
+    int mask = memory->index_capacity - 1;
+    int slot = (int)(hash & (unsigned int)mask);
+    long probes = 1;
+
+    while (memory->index[slot] != -1) {
+      int cell = memory->index[slot];
+      if (memory->hashes[cell] == hash && strcmp(memory->identifiers[cell], identifier) == 0) {
+        ram_count_probes(memory, probes);
+        return memory->base + cell;
+      }
+      slot = (slot + 1) & mask;
+      probes++;
+    }
+    ram_count_probes(memory, probes);
+  }
+  if (memory->parent != NULL) return ram_find(memory->parent, identifier, hash);
+  return -1;
+}
+
+
+//
+// ram_append_cell
+//
+// Appends a new, undefined cell named by the given identifier,
+// growing the cell array and the hash index as needed. Returns
+// the address of the new cell.
+//
+static int ram_append_cell(struct RAM* memory, char* identifier, unsigned int hash)
+{
+  bool grew = false;
+  int cell = memory->num_values - memory->base;
+  if (cell >= memory->capacity) {
+    ram_resize_cells(memory, memory->capacity == 0 ? 4 : memory->capacity * 2);
+    RAM_COUNT(memory, grow_events, 1);
+    grew = true;
+  }
+  int address = memory->num_values;
+  memory->num_values++;
+  memory->identifiers[cell] = arena_strdup(memory->names, identifier);
+  memory->hashes[cell] = hash;
+  ram_cell_set_type(memory, address, RAM_TYPE_UNDEFINED);
+
+  // keep the index in sync: a resize reinserts everything,
+  // including the new cell, otherwise just add the new cell
+  if (grew) ram_index_rebuild(memory);
+  else ram_index_insert(memory, cell);
+  ram_update_footprint(memory);
+
+  return address;
+}
+
+
 //
 // ram_get_addr
 // 
@@ -57,10 +645,75 @@ void ram_destroy(struct RAM* memory)
 //
 int ram_get_addr(struct RAM* memory, char* identifier)
 {
-  for (int i = 0; i < memory->num_values; i++) {
-    if (memory->cells[i].identifier != NULL && strcmp(memory->cells[i].identifier, identifier) == 0) return i;
-  }
-  return -1;
+  int address = ram_find(memory, identifier, ram_hash(identifier));
+  if (address == -1 || ram_cell_type(memory, address) == RAM_TYPE_UNDEFINED) return -1;
+  return address;
+}
+
+
+//
+// ram_reserve_addr
+//
+// Returns the address of the memory cell named by the given
+// identifier, creating the cell if necessary. A newly created
+// cell is undefined: reads by address or name fail until the
+// cell is first written. Addresses never change once assigned,
+// so callers may bind identifiers to addresses ahead of time.
+// Returns -1 if the cell would have to be created in a memory
+// that is frozen by a fork.
+//
+int ram_reserve_addr(struct RAM* memory, char* identifier)
+{
+  unsigned int hash = ram_hash(identifier);
+  int address = ram_find(memory, identifier, hash);
+  if (address != -1) return address;
+  if (memory->num_forks > 0) return -1;
+  return ram_append_cell(memory, identifier, hash);
+}
+
+
+//
+// ram_cell_export
+//
+// Returns the value in the cell at the given address for a
+// caller outside the memory. A string still in a restored
+// memory's mapped image is first replaced, in its cell, by a
+// heap copy that the cell owns from then on, since the image
+// goes away with the memory but a string handed out may be
+// kept or written elsewhere. The copy is made once; later
+// reads share it. No reference is taken.
+//
+static struct RAM_VALUE ram_cell_export(struct RAM* memory, int address)
+{
+  struct RAM_VALUE value = ram_cell_load(memory, address);
+  if (value.value_type != RAM_TYPE_STR) return value;
+
+  // a shared cell is the parent's; a fork's own cells never point
+  // into an image, since no image string ever leaves its memory
+  struct RAM* owner = memory;
+  while (address < owner->base) owner = owner->parent;
+  char* at = (char*)value.types.str;
+  if (owner->image == NULL || at < (char*)owner->image || at >= (char*)owner->image + owner->image_size) return value;
+
+  value.types.str = ram_str_create(value.types.str->chars, value.types.str->length);
+  ram_cell_store(owner, address, value);
+  return value;
+}
+
+
+//
+// ram_copy_cell
+//
+// Returns a heap copy of the value in the (valid, defined)
+// cell at the given address, holding its own reference to
+// a string.
+//
+static struct RAM_VALUE* ram_copy_cell(struct RAM* memory, int address)
+{
+  struct RAM_VALUE* value = (struct RAM_VALUE*)malloc(sizeof(struct RAM_VALUE));
+  *value = ram_cell_export(memory, address);
+  if (value->value_type == RAM_TYPE_STR) ram_str_retain(value->types.str);
+  return value;
 }
 
 
@@ -68,22 +721,19 @@ int ram_get_addr(struct RAM* memory, char* identifier)
 // ram_read_cell_by_addr
 //
 // Given a memory address returns a COPY of 
-// the value contained in that memory cell.
-// Returns null if the address is not valid.
+// the value contained in that memory cell. A
+// string is shared with memory, not duplicated;
+// ram_free_value releases the copy's reference.
+// Returns null if the address is not valid or
+// the cell has not been written yet.
 //
 struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address)
 {
+  RAM_COUNT(memory, reads_by_addr, 1);
   if (address < 0 || address >= memory->num_values) return NULL;
+  if (ram_cell_type(memory, address) == RAM_TYPE_UNDEFINED) return NULL;
   
-  struct RAM_VALUE* value = (struct RAM_VALUE*)malloc(sizeof(struct RAM_VALUE));
-  *value = memory->cells[address].value;
-  if (value->value_type == RAM_TYPE_STR) {
-    char* temp_string = (char*)malloc(strlen(memory->cells[address].value.types.s) + 1);
-    strcpy(temp_string, memory->cells[address].value.types.s);
-    value->types.s = temp_string;
-  }
-
-  return value;
+  return ram_copy_cell(memory, address);
 }
 
 
@@ -96,9 +746,46 @@ struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address)
 //
 struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* name)
 {
+  RAM_COUNT(memory, reads_by_name, 1);
   int index = ram_get_addr(memory, name);
   if (index == -1) return NULL;
-  return ram_read_cell_by_addr(memory, index);
+  return ram_copy_cell(memory, index);
+}
+
+
+//
+// ram_peek_cell_by_addr
+//
+// Given a memory address, fills in the caller's value with
+// the value contained in that memory cell, without making a
+// copy. A string is borrowed: it remains owned by memory and
+// is only valid until that cell is next written. Returns false
+// (and leaves value untouched) if the address is not valid or
+// the cell has not been written yet.
+//
+bool ram_peek_cell_by_addr(struct RAM* memory, int address, struct RAM_VALUE* value)
+{
+  RAM_COUNT(memory, reads_by_addr, 1);
+  if (address < 0 || address >= memory->num_values) return false;
+  if (ram_cell_type(memory, address) == RAM_TYPE_UNDEFINED) return false;
+
+  *value = ram_cell_export(memory, address);
+  return true;
+}
+
+
+//
+// ram_peek_cell_by_name
+//
+// Same as ram_peek_cell_by_addr, but looks the cell up by name.
+//
+bool ram_peek_cell_by_name(struct RAM* memory, char* name, struct RAM_VALUE* value)
+{
+  RAM_COUNT(memory, reads_by_name, 1);
+  int index = ram_get_addr(memory, name);
+  if (index == -1) return false;
+  *value = ram_cell_export(memory, index);
+  return true;
 }
 
 
@@ -111,33 +798,87 @@ struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* name)
 void ram_free_value(struct RAM_VALUE* value)
 {
   if (value == NULL) return;
-  if (value->value_type == RAM_TYPE_STR) free(value->types.s);
+  if (value->value_type == RAM_TYPE_STR) ram_str_release(value->types.str);
   free(value);
   return;
 }
 
 
+//
+// ram_write_shared
+//
+// Writes a cell that a fork shares with its parent. The first
+// write copies the cell into the fork's overrides; the parent's
+// value, which the fork never owned, is left alone.
+//
+static bool ram_write_shared(struct RAM* memory, struct RAM_VALUE value, int address)
+{
+  if ((memory->num_overrides + 1) * 2 > memory->override_capacity) ram_grow_overrides(memory);
+
+  int slot = ram_override_slot(memory, address);
+  struct RAM_STR* old_string = NULL;
+  if (memory->overrides[slot] == address) {
+    if (memory->override_values[slot].value_type == RAM_TYPE_STR) old_string = memory->override_values[slot].types.str;
+  }
+  else {
+    // a cell the parent only reserved is first defined here
+    memory->overrides[slot] = address;
+    memory->override_sequence[slot] = ram_cell_type(memory->parent, address) == RAM_TYPE_UNDEFINED ? memory->next_sequence++ : -1;
+    memory->num_overrides++;
+  }
+
+  if (value.value_type == RAM_TYPE_STR) ram_str_retain(value.types.str);
+  memory->override_values[slot] = value;
+  ram_str_release(old_string);
+  return true;
+}
+
+
+//
+// ram_write_cell
+//
+// Writes the given value to the (valid) cell at the given
+// address of a memory that is not frozen.
+//
+static bool ram_write_cell(struct RAM* memory, struct RAM_VALUE value, int address)
+{
+  if (address < memory->base) return ram_write_shared(memory, value, address);
+
+  // take the new reference before dropping the old one, since a
+  // value peeked from this very cell borrows the old string
+  struct RAM_STR* old_string = NULL;
+  RAM_VALUE_TYPE old_type = ram_cell_type(memory, address);
+  if (old_type == RAM_TYPE_STR) old_string = ram_cell_load(memory, address).types.str;
+  else if (old_type == RAM_TYPE_UNDEFINED) {
+    memory->sequence[address - memory->base] = memory->next_sequence++;
+    memory->num_defined++;
+    if (memory->num_defined > memory->defined_capacity)
+      memory->defined_capacity = memory->defined_capacity == 0 ? 4 : memory->defined_capacity * 2;
+  }
+
+  if (value.value_type == RAM_TYPE_STR) ram_str_retain(value.types.str);
+  ram_cell_store(memory, address, value);
+  ram_str_release(old_string);
+  return true;
+}
+
+
 //
 // ram_write_cell_by_addr
 //
 // Writes the given value to the memory cell at the given 
 // address. If a value already exists at this address, that
-// value is overwritten by this new value. Returns true if 
-// the value was successfully written, false if not
+// value is overwritten by this new value. A string is
+// shared rather than copied: the cell takes its own
+// reference, and the caller keeps theirs. Returns true if 
+// the value was successfully written, false if not (including
+// when the memory is frozen by a fork)
 //
 bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int address) {
-  if (address < 0 || address >= memory->capacity || memory->cells[address].identifier == NULL) return false;
-  if (memory->cells[address].value.value_type == RAM_TYPE_STR) free(memory->cells[address].value.types.s);
-
-  memory->cells[address].value.value_type = value.value_type;
-  if (value.value_type == RAM_TYPE_INT || value.value_type == RAM_TYPE_BOOLEAN || value.value_type == RAM_TYPE_PTR) memory->cells[address].value.types.i = value.types.i;
-  else if (value.value_type == RAM_TYPE_REAL) memory->cells[address].value.types.d = value.types.d;
-  else if (value.value_type == RAM_TYPE_STR) {
-    char* temp_string = (char*)malloc(strlen(value.types.s) + 1);
-    strcpy(temp_string, value.types.s);
-    memory->cells[address].value.types.s = temp_string;
-  }
-  return true;
+  RAM_COUNT(memory, writes_by_addr, 1);
+  if (address < 0 || address >= memory->num_values) return false;
+  if (memory->num_forks > 0) return false;
+  return ram_write_cell(memory, value, address);
 }
 
 
@@ -147,54 +888,314 @@ bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int addr
 // Writes the given value to a memory cell named by the given
 // name. If a memory cell already exists with this name, the
 // existing value is overwritten by the given value. Returns
-// true since this operation always succeeds.
+// true unless the memory is frozen by a fork.
 //
 bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* name)
 {
-  int index = ram_get_addr(memory, name);
-  if (index != -1) return ram_write_cell_by_addr(memory, value, index);
-
-  if (memory->num_values >= memory->capacity) {
-    memory->capacity *= 2;
-    memory->cells = (struct RAM_CELL*)realloc(memory->cells, memory->capacity * sizeof(struct RAM_CELL));
-    for (int i = memory->num_values; i < memory->capacity; i++) {
-      memory->cells[i].identifier = NULL;
-      memory->cells[i].value.value_type = RAM_TYPE_NONE;
-    }
+  RAM_COUNT(memory, writes_by_name, 1);
+  if (memory->num_forks > 0) return false;
+
+  unsigned int hash = ram_hash(name);
+  int index = ram_find(memory, name, hash);
+  if (index == -1) index = ram_append_cell(memory, name, hash);
+  return ram_write_cell(memory, value, index);
+}
+
+
+//
+// ram_print_capacity
+//
+// Returns the capacity ram_print reports: the memory's defined
+// capacity, plus for a fork its parent's, which holds the
+// cells the fork shares.
+//
+static int ram_print_capacity(struct RAM* memory)
+{
+  int capacity = memory->defined_capacity;
+  if (memory->parent != NULL) capacity += ram_print_capacity(memory->parent);
+  return capacity;
+}
+
+
+//
+// ram_definition_order
+//
+// Returns the addresses of the defined cells in the order they
+// were first written, in a malloc'ed array, and sets count to
+// the number of them. Cells reserved by ram_reserve_addr but
+// never written are left out.
+//
+static int* ram_definition_order(struct RAM* memory, int* count)
+{
+  // sequence numbers are unique and below next_sequence, so they
+  // index the cells directly
+  int* by_sequence = (int*)malloc((memory->next_sequence + 1) * sizeof(int));
+  for (int i = 0; i < memory->next_sequence; i++) by_sequence[i] = -1;
+  for (int i = 0; i < memory->num_values; i++) {
+    int sequence = ram_cell_sequence(memory, i);
+    if (sequence != -1) by_sequence[sequence] = i;
   }
-  memory->num_values++;
-  char* temp_identifier = (char*)malloc(strlen(name) + 1);
-  strcpy(temp_identifier, name);
-  memory->cells[memory->num_values-1].identifier = temp_identifier;
-  return ram_write_cell_by_addr(memory, value, memory->num_values-1);
+
+  *count = 0;
+  for (int i = 0; i < memory->next_sequence; i++)
+    if (by_sequence[i] != -1) by_sequence[(*count)++] = by_sequence[i];
+  return by_sequence;
 }
 
 
 //
 // ram_print
 //
-// Prints the contents of memory to the console.
+// Prints the contents of memory to the console, numbering
+// the defined cells in the order they were first written,
+// as they were numbered when cells were only created then.
 //
 void ram_print(struct RAM* memory)
 {
   printf("**MEMORY PRINT**\n");
 
-  printf("Capacity: %d\n", memory->capacity);
-  printf("Num values: %d\n", memory->num_values);
+  // cells reserved by ram_reserve_addr but never written are not values
+  // yet, and are left out of the numbering as well as the count
+  int num_defined;
+  int* order = ram_definition_order(memory, &num_defined);
+
+  printf("Capacity: %d\n", ram_print_capacity(memory));
+  printf("Num values: %d\n", num_defined);
   printf("Contents:\n");
 
-  for (int i = 0; i < memory->num_values; i++)
+  for (int n = 0; n < num_defined; n++)
   {
-      printf(" %d: %s, ", i, memory->cells[i].identifier);
-      if (memory->cells[i].value.value_type == RAM_TYPE_INT) printf("int, %d", memory->cells[i].value.types.i);
-      else if (memory->cells[i].value.value_type == RAM_TYPE_REAL) printf("real, %lf", memory->cells[i].value.types.d);
-      else if (memory->cells[i].value.value_type == RAM_TYPE_STR) printf("str, '%s'", memory->cells[i].value.types.s);
-      else if (memory->cells[i].value.value_type == RAM_TYPE_PTR) printf("ptr, %d", memory->cells[i].value.types.i);
-      else if (memory->cells[i].value.value_type == RAM_TYPE_BOOLEAN && memory->cells[i].value.types.i == 0) printf("boolean, False");
-      else if (memory->cells[i].value.value_type == RAM_TYPE_BOOLEAN && memory->cells[i].value.types.i == 1) printf("boolean, False");
-      else if (memory->cells[i].value.value_type == RAM_TYPE_NONE) printf("none, None");
+      int i = order[n];
+      struct RAM_VALUE value = ram_cell_load(memory, i);
+      printf(" %d: %s, ", n, ram_cell_identifier(memory, i));
+      if (value.value_type == RAM_TYPE_INT) printf("int, %d", value.types.i);
+      else if (value.value_type == RAM_TYPE_REAL) printf("real, %lf", value.types.d);
+      else if (value.value_type == RAM_TYPE_STR) printf("str, '%s'", value.types.str->chars);
+      else if (value.value_type == RAM_TYPE_PTR) printf("ptr, %d", value.types.i);
+      else if (value.value_type == RAM_TYPE_BOOLEAN && value.types.i == 0) printf("boolean, False");
+      else if (value.value_type == RAM_TYPE_BOOLEAN && value.types.i == 1) printf("boolean, False");
+      else if (value.value_type == RAM_TYPE_NONE) printf("none, None");
       printf("\n");
   }
+  free(order);
 
   printf("**END PRINT**\n");
-}
\ No newline at end of file
+}
+
+
+//
+// ram_get_stats
+//
+// Returns a copy of the memory's counters, including the
+// bytes allocated for strings by all memories so far.
+//
+struct RAM_STATS ram_get_stats(struct RAM* memory)
+{
+  struct RAM_STATS stats = memory->stats;
+#ifndef RAM_NO_STATS
+  stats.string_bytes = ram_string_bytes;
+#endif
+  return stats;
+}
+
+
+//
+// ram_print_stats
+//
+// Prints the memory's counters to the console.
+//
+void ram_print_stats(struct RAM* memory)
+{
+  struct RAM_STATS stats = ram_get_stats(memory);
+
+  printf("**MEMORY STATS**\n");
+  printf("Reads by name: %ld\n", stats.reads_by_name);
+  printf("Reads by address: %ld\n", stats.reads_by_addr);
+  printf("Writes by name: %ld\n", stats.writes_by_name);
+  printf("Writes by address: %ld\n", stats.writes_by_addr);
+  printf("Lookups: %ld\n", stats.lookups);
+  printf("Average probe length: %.2f\n", stats.lookups == 0 ? 0.0 : (double)stats.lookup_probes / stats.lookups);
+  printf("Max probe length: %ld\n", stats.max_probe_length);
+  printf("Capacity doublings: %ld\n", stats.grow_events);
+  printf("String bytes allocated: %ld\n", stats.string_bytes);
+  printf("Footprint: %ld bytes (peak %ld)\n", stats.footprint, stats.peak_footprint);
+  printf("**END STATS**\n");
+}
+
+//
+// ram_snapshot
+//
+// Writes every cell of memory, strings included, to a binary
+// image at the given path that ram_restore can map back in.
+// Undefined cells are kept so addresses survive the round
+// trip, as does the order cells were defined in, and a fork
+// is written out together with the cells it shares with its
+// parent. Returns true if the image was
+// written, false if not.
+//
+bool ram_snapshot(struct RAM* memory, const char* path)
+{
+  // size the image: header, cell records, identifiers, strings
+  size_t names_offset = sizeof(struct RAM_IMAGE_HEADER) + memory->num_values * sizeof(struct RAM_IMAGE_CELL);
+  size_t strings_offset = names_offset;
+  for (int i = 0; i < memory->num_values; i++) strings_offset += strlen(ram_cell_identifier(memory, i)) + 1;
+  strings_offset = (strings_offset + 7) & ~(size_t)7;
+
+  size_t size = strings_offset;
+  for (int i = 0; i < memory->num_values; i++) {
+    if (ram_cell_type(memory, i) != RAM_TYPE_STR) continue;
+    size += (sizeof(struct RAM_STR) + ram_cell_load(memory, i).types.str->length + 1 + 7) & ~(size_t)7;
+  }
+
+  char* image = (char*)calloc(1, size);
+  struct RAM_IMAGE_HEADER* header = (struct RAM_IMAGE_HEADER*)image;
+  memcpy(header->magic, RAM_IMAGE_MAGIC, sizeof(header->magic));
+  header->version = RAM_IMAGE_VERSION;
+  header->num_values = (uint32_t)memory->num_values;
+  header->size = size;
+  header->defined_capacity = (uint32_t)ram_print_capacity(memory);
+
+  struct RAM_IMAGE_CELL* cells = (struct RAM_IMAGE_CELL*)(image + sizeof(struct RAM_IMAGE_HEADER));
+  int num_defined;
+  int* order = ram_definition_order(memory, &num_defined);
+  for (int i = 0; i < memory->num_values; i++) cells[i].sequence = -1;
+  for (int n = 0; n < num_defined; n++) cells[order[n]].sequence = n;
+  free(order);
+
+  size_t name_at = names_offset;
+  size_t string_at = strings_offset;
+  for (int i = 0; i < memory->num_values; i++) {
+    struct RAM_VALUE value = ram_cell_load(memory, i);
+    cells[i].value_type = value.value_type;
+    cells[i].hash = ram_cell_hash(memory, i);
+
+    size_t length = strlen(ram_cell_identifier(memory, i)) + 1;
+    memcpy(image + name_at, ram_cell_identifier(memory, i), length);
+    cells[i].identifier = name_at;
+    name_at += length;
+
+    if (value.value_type == RAM_TYPE_REAL) cells[i].value.d = value.types.d;
+    else if (value.value_type == RAM_TYPE_STR) {
+      struct RAM_STR* str = (struct RAM_STR*)(image + string_at);
+      str->refcount = RAM_STR_STATIC;
+      str->length = value.types.str->length;
+      memcpy(str->chars, value.types.str->chars, str->length + 1);
+      cells[i].value.str = string_at;
+      string_at += (sizeof(struct RAM_STR) + str->length + 1 + 7) & ~(size_t)7;
+    }
+    else cells[i].value.i = value.types.i;
+  }
+
+  FILE* output = fopen(path, "wb");
+  bool success = output != NULL && fwrite(image, 1, size, output) == size;
+  if (output != NULL && fclose(output) != 0) success = false;
+  free(image);
+  return success;
+}
+
+
+//
+// ram_image_string_fits
+//
+// Returns true if the string record at the given offset of
+// the image fits in it: the offset is aligned, the RAM_STR
+// header fits, and the characters its length gives, with
+// their terminating NUL, fit after the header. The record
+// must also be marked static, as ram_snapshot writes it.
+//
+static bool ram_image_string_fits(const char* image, size_t size, size_t offset)
+{
+  if (offset % 8 != 0 || offset > size || size - offset < sizeof(struct RAM_STR)) return false;
+
+  struct RAM_STR* str = (struct RAM_STR*)(image + offset);
+  size_t room = size - offset - sizeof(struct RAM_STR);
+  return str->refcount == RAM_STR_STATIC && str->length >= 0 && (size_t)str->length < room && str->chars[str->length] == '\0';
+}
+
+
+//
+// ram_restore
+//
+// Returns a new memory holding the cells of the image at the
+// given path, or NULL if the image cannot be read or is not
+// a valid image of this version. The image is mapped rather
+// than read: identifiers and strings are used in place, and
+// a string is only replaced by a heap copy when its cell is
+// first read or overwritten (see ram_cell_export). Stored
+// hashes are checked against the identifiers, since lookups
+// trust them. The mapping is released by ram_destroy.
+//
+struct RAM* ram_restore(const char* path)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct RAM_IMAGE_HEADER)) {
+    close(fd);
+    return NULL;
+  }
+  size_t size = (size_t)st.st_size;
+  char* image = (char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED) return NULL;
+
+  // validate everything before trusting any offset
+  struct RAM_IMAGE_HEADER* header = (struct RAM_IMAGE_HEADER*)image;
+  bool valid = memcmp(header->magic, RAM_IMAGE_MAGIC, sizeof(header->magic)) == 0
+            && header->version == RAM_IMAGE_VERSION
+            && header->size == size
+            && header->num_values <= (size - sizeof(struct RAM_IMAGE_HEADER)) / sizeof(struct RAM_IMAGE_CELL);
+  struct RAM_IMAGE_CELL* cells = (struct RAM_IMAGE_CELL*)(image + sizeof(struct RAM_IMAGE_HEADER));
+  uint32_t num_defined = 0;
+  for (uint32_t i = 0; valid && i < header->num_values; i++) {
+    if (cells[i].value_type != RAM_TYPE_UNDEFINED) num_defined++;
+    if (cells[i].identifier >= size || memchr(image + cells[i].identifier, '\0', size - cells[i].identifier) == NULL) valid = false;
+    else if (cells[i].hash != ram_hash(image + cells[i].identifier)) valid = false;
+    else if (cells[i].value_type > RAM_TYPE_UNDEFINED) valid = false;
+    else if (cells[i].value_type == RAM_TYPE_STR && !ram_image_string_fits(image, size, cells[i].value.str)) valid = false;
+  }
+
+  // the defined cells must be numbered 0 up, each number used once
+  bool* numbered = valid ? (bool*)calloc(num_defined + 1, sizeof(bool)) : NULL;
+  for (uint32_t i = 0; valid && i < header->num_values; i++) {
+    int32_t sequence = cells[i].sequence;
+    if (cells[i].value_type == RAM_TYPE_UNDEFINED) valid = sequence == -1;
+    else if (sequence < 0 || (uint32_t)sequence >= num_defined || numbered[sequence]) valid = false;
+    else numbered[sequence] = true;
+  }
+  free(numbered);
+  if (valid && (header->defined_capacity < num_defined || header->defined_capacity > INT_MAX)) valid = false;
+  if (!valid) {
+    munmap(image, size);
+    return NULL;
+  }
+
+  struct RAM* memory = ram_init();
+  int capacity = memory->capacity;
+  while (capacity < (int)header->num_values) capacity *= 2;
+  if (capacity != memory->capacity) ram_resize_cells(memory, capacity);
+
+  for (uint32_t i = 0; i < header->num_values; i++) {
+    struct RAM_VALUE value;
+    value.value_type = (RAM_VALUE_TYPE)cells[i].value_type;
+    if (value.value_type == RAM_TYPE_REAL) value.types.d = cells[i].value.d;
+    else if (value.value_type == RAM_TYPE_STR) value.types.str = (struct RAM_STR*)(image + cells[i].value.str);
+    else value.types.i = (int)cells[i].value.i;
+
+    memory->identifiers[i] = image + cells[i].identifier;
+    memory->hashes[i] = cells[i].hash;
+    memory->sequence[i] = cells[i].sequence;
+    ram_cell_store(memory, (int)i, value);
+  }
+  memory->num_values = (int)header->num_values;
+  memory->next_sequence = (int)num_defined;
+  memory->num_defined = (int)num_defined;
+  memory->defined_capacity = (int)header->defined_capacity;
+  ram_index_rebuild(memory);
+
+  memory->image = image;
+  memory->image_size = size;
+  ram_update_footprint(memory);
+  return memory;
+}
@@ -2,6 +2,9 @@
 #define RAM_H
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#include "arena.h"
 
 typedef enum {
     RAM_TYPE_NONE,
@@ -9,41 +12,138 @@ typedef enum {
     RAM_TYPE_REAL,
     RAM_TYPE_STR,
     RAM_TYPE_PTR,
-    RAM_TYPE_BOOLEAN
+    RAM_TYPE_BOOLEAN,
+    RAM_TYPE_UNDEFINED   // cell reserved by ram_reserve_addr but not yet written
 } RAM_VALUE_TYPE;
 
-// Define the structure for RAM_VALUE, which can hold different types of values
+// Define the structure for an immutable, reference-counted string. The
+// characters follow the header in the same allocation and are NUL-terminated,
+// so chars can be passed anywhere a C string is expected. A string whose
+// refcount is RAM_STR_STATIC is not heap-allocated (for example, it lives in
+// a mapped RAM image) and is never modified or freed by retain and release.
+#define RAM_STR_STATIC -1
+
+struct RAM_STR {
+    int refcount;
+    int length;
+    char chars[];
+};
+
+// Define the payload of a value; which member is valid depends on its type
+union RAM_PAYLOAD {
+    int i;
+    double d;
+    struct RAM_STR* str;
+};
+
+// Define the structure for RAM_VALUE, which can hold different types of values.
+// A RAM_TYPE_STR value holds a reference to a shared RAM_STR.
 struct RAM_VALUE {
     RAM_VALUE_TYPE value_type;
-    union {
-        int i;
-        double d;
-        char* s;
-    } types;
+    union RAM_PAYLOAD types;
 };
 
-// Define the structure for a memory cell, which has an identifier and a RAM_VALUE
-struct RAM_CELL {
-    char* identifier;
-    struct RAM_VALUE value;
+// Define the counters kept by each memory; see ram_get_stats. Building with
+// RAM_NO_STATS defined compiles the counting out, and every counter reads 0.
+struct RAM_STATS {
+    long reads_by_name;
+    long reads_by_addr;
+    long writes_by_name;
+    long writes_by_addr;
+    long lookups;            // hash index searches by identifier
+    long lookup_probes;      // index slots examined by all lookups
+    long max_probe_length;   // most slots examined by a single lookup
+    long grow_events;        // doublings of the cell capacity
+    long string_bytes;       // bytes allocated for strings, by all memories
+    long footprint;          // bytes currently held by cells, index and names
+    long peak_footprint;
 };
 
-// Define the RAM structure, which includes a dynamic array of cells
+// An 8-byte NaN-boxed encoding of a RAM_VALUE; see nanbox.h
+typedef uint64_t RAM_BOX;
+
+// Define the RAM structure. Cells are stored as parallel arrays indexed by
+// address, so the hot data (type tags and payloads) is contiguous and loops
+// over values never pull the cold identifiers and hashes into cache. Building
+// with RAM_NANBOX defined replaces the types and payloads arrays with a single
+// array of 8-byte RAM_BOXes.
+//
+// The hash index maps identifiers to addresses by open addressing. It holds
+// cell addresses (-1 marks an empty slot) and always has twice as many slots
+// as there are cells, so the load factor never exceeds 1/2. Identifiers are
+// allocated from the names arena and released all at once by ram_destroy.
+// A RAM created by ram_restore also keeps its image mapped: identifiers and
+// strings restored from it point into the image, but a string is copied to
+// the heap before it is first handed out, so no value read from the memory
+// points into the image.
+//
+// Cells can be reserved (see ram_reserve_addr) before they are written, so
+// the order of addresses is not the order cells were defined in. Each cell's
+// sequence number records that order instead: next_sequence is given to a
+// cell when it is first written, and -1 means not written yet. ram_print lists
+// cells by sequence number. For the same reason ram_print does not report
+// capacity, which reserved cells grow too, but defined_capacity: the capacity
+// the memory would have grown to had cells only been created when written,
+// kept up to date as num_defined cells are first written.
+//
+// A RAM created by ram_fork shares the first base cells with its parent. The
+// cell arrays, identifiers, hashes and index of a fork hold only the cells it
+// added, at address - base. A shared cell that the fork writes is copied into
+// the overrides table, an open-addressing map from address to value (and,
+// for a shared cell first written by the fork, its sequence number). A RAM
+// with live forks (num_forks > 0) is frozen and rejects every write.
 struct RAM {
     int num_values;
     int capacity;
-    struct RAM_CELL* cells;
+#ifdef RAM_NANBOX
+    RAM_BOX* boxes;
+#else
+    unsigned char* types;
+    union RAM_PAYLOAD* payloads;
+#endif
+    char** identifiers;
+    unsigned int* hashes;
+    int* sequence;
+    int next_sequence;
+    int num_defined;
+    int defined_capacity;
+    int* index;
+    int index_capacity;
+    struct ARENA* names;
+    void* image;
+    size_t image_size;
+    struct RAM* parent;
+    int base;
+    int num_forks;
+    int* overrides;
+    struct RAM_VALUE* override_values;
+    int* override_sequence;
+    int num_overrides;
+    int override_capacity;
+    struct RAM_STATS stats;
 };
 
 // Function declarations for ram.c
+struct RAM_STR* ram_str_create(const char* chars, int length);
+struct RAM_STR* ram_str_concat(struct RAM_STR* lhs, struct RAM_STR* rhs);
+struct RAM_STR* ram_str_retain(struct RAM_STR* str);
+void ram_str_release(struct RAM_STR* str);
 struct RAM* ram_init(void);
 void ram_destroy(struct RAM* memory);
+struct RAM* ram_fork(struct RAM* parent);
 int ram_get_addr(struct RAM* memory, char* identifier);
+int ram_reserve_addr(struct RAM* memory, char* identifier);
 struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address);
 struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* name);
+bool ram_peek_cell_by_addr(struct RAM* memory, int address, struct RAM_VALUE* value);
+bool ram_peek_cell_by_name(struct RAM* memory, char* name, struct RAM_VALUE* value);
 void ram_free_value(struct RAM_VALUE* value);
 bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int address);
 bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* name);
 void ram_print(struct RAM* memory);
+struct RAM_STATS ram_get_stats(struct RAM* memory);
+void ram_print_stats(struct RAM* memory);
+bool ram_snapshot(struct RAM* memory, const char* path);
+struct RAM* ram_restore(const char* path);
 
 #endif // RAM_H
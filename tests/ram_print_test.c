@@ -0,0 +1,126 @@
+//
+// ram_print_test
+//
+// Checks that ram_print numbers variables in the order they were first
+// written, even though execute_resolve reserves a cell for every name up
+// front, in source order. The script below first names q in a loop body
+// that never runs, so q's cell is reserved before r's but written after
+// it. The script is run by the tree walker and by the VM, with the graph
+// built eagerly and lazily. Build and run from the repository root:
+//
+//   gcc -pthread -Iparser -Iram -Iarena -Iexecute/executor tests/ram_print_test.c execute/executor/execute.c execute/executor/vm.c parser/parser.c parser/tokenqueue.c parser/intern.c parser/scanbuffer.c parser/scanparallel.c parser/scanner.c ram/ram.c arena/arena.c -lm -o ram_print_test && ./ram_print_test
+//
+// It prints one line per case and exits with 1 if any case fails.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "scanner.h"
+#include "parser.h"
+#include "execute.h"
+#include "vm.h"
+
+static const char* SCRIPT =
+  "i = 0\n"
+  "while i > 5:\n"
+  "{\n"
+  "  q = 1\n"
+  "}\n"
+  "r = 2\n"
+  "q = 3\n"
+  "$\n";
+
+static const char* EXPECTED =
+  "**MEMORY PRINT**\n"
+  "Capacity: 4\n"
+  "Num values: 3\n"
+  "Contents:\n"
+  " 0: i, int, 0\n"
+  " 1: r, int, 2\n"
+  " 2: q, int, 3\n"
+  "**END PRINT**\n";
+
+//
+// print_memory
+//
+// Returns what ram_print writes for the memory, in a malloc'ed
+// string, by pointing stdout at a temporary file for the call.
+//
+static char* print_memory(struct RAM* memory)
+{
+  FILE* capture = tmpfile();
+  fflush(stdout);
+  int saved = dup(fileno(stdout));
+  dup2(fileno(capture), fileno(stdout));
+  ram_print(memory);
+  fflush(stdout);
+  dup2(saved, fileno(stdout));
+  close(saved);
+
+  long length = ftell(capture);
+  char* text = (char*)malloc(length + 1);
+  rewind(capture);
+  text[fread(text, 1, length, capture)] = '\0';
+  fclose(capture);
+  return text;
+}
+
+//
+// run_case
+//
+// Runs the script with the given engine and graph building, and
+// returns true if ram_print's output is the expected one.
+//
+static bool run_case(const char* path, bool lazy, bool useVM)
+{
+  struct ScannerSource source;
+  scanner_openFile(&source, path);
+  struct ARENA* arena = arena_init();
+  struct LAZY_SOURCE* deferred = NULL;
+  struct STMT* program = lazy ? parser_parseProgramLazy(&source, arena, &deferred) : parser_parseProgramSource(&source, arena);
+
+  bool passed = false;
+  if (program != NULL) {
+    struct RAM* memory = ram_init();
+    execute_fold(program, arena);
+    execute_resolve(program, memory);
+    if (useVM) {
+      struct VM_PROGRAM* vm = vm_compile(program);
+      vm_run(vm, memory);
+      vm_destroy(vm);
+    }
+    else
+      execute(program, memory);
+
+    char* printed = print_memory(memory);
+    passed = strcmp(printed, EXPECTED) == 0;
+    if (!passed) printf("ram_print wrote:\n%s", printed);
+    free(printed);
+    ram_destroy(memory);
+  }
+
+  parser_releaseLazy(deferred);
+  arena_destroy(arena);
+  scanner_close(&source);
+  printf("%s: %s, %s\n", passed ? "PASS" : "FAIL", useVM ? "vm" : "tree", lazy ? "lazy" : "eager");
+  return passed;
+}
+
+int main(void)
+{
+  char path[] = "/tmp/ram_print_test_XXXXXX";
+  FILE* output = fdopen(mkstemp(path), "w");
+  fputs(SCRIPT, output);
+  fclose(output);
+
+  bool passed = true;
+  for (int lazy = 0; lazy <= 1; lazy++)
+    for (int useVM = 0; useVM <= 1; useVM++)
+      if (!run_case(path, lazy, useVM)) passed = false;
+
+  remove(path);
+  return passed ? 0 : 1;
+}